@@ -1,23 +1,46 @@
 #version 400 core
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aNormal;
-layout(location = 2) in vec3 aColor;
+// Packed chunk vertex, see Voxel::Chunk::VertexFormat
+// bits 0-6 x, 7-13 y, 14-20 z (in blocks), 21-23 face, 24-31 material
+layout(location = 0) in uint aPacked;
 
 uniform mat4 transform;
 uniform mat4 projectedview;
 uniform vec3 lightPos;
-uniform mat4 worldoffset;
+uniform float blockSize;
 
 out vec3 Normal;
 out vec3 ToLightVec;
 out vec3 Color;
 
+// Same normals the float path derives from the quad winding
+const vec3 FaceNormals[5] = vec3[5](
+    vec3(-1.f, 0.f, 0.f),   // Left
+    vec3(-1.f, 0.f, 0.f),   // Right
+    vec3(0.f, 0.f, 1.f),    // Front
+    vec3(0.f, 0.f, 1.f),    // Back
+    vec3(0.f, -1.f, 0.f)    // Top
+);
+
+// Indexed by Chunk::BlockType
+const vec3 Palette[3] = vec3[3](
+    vec3(0.f, 0.f, 0.f),        // None
+    vec3(0.f, 0.8f, 0.1f),      // Block
+    vec3(0.45f, 0.3f, 0.15f)    // Dirt
+);
+
 void main()
 {
-    //vec4 WorldPos = worldoffset * transform * vec4(aPos, 1.f);
-    vec4 WorldPos = transform * vec4(aPos, 1.f);
+    vec3 pos = vec3(
+        float(aPacked & 127u),
+        float((aPacked >> 7) & 127u),
+        float((aPacked >> 14) & 127u)
+    ) * blockSize;
+    uint face = min((aPacked >> 21) & 7u, 4u);
+    uint material = min(aPacked >> 24, 2u);
+
+    vec4 WorldPos = transform * vec4(pos, 1.f);
     gl_Position = projectedview * WorldPos;
-    Normal = mat3(transpose(inverse(transform))) * aNormal;//aNormal;
-    Color = aColor;
+    Normal = mat3(transform) * FaceNormals[face];
+    Color = Palette[material];
     ToLightVec = lightPos - WorldPos.xyz;
-}
\ No newline at end of file
+}
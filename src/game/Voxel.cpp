@@ -1,8 +1,19 @@
 #include "Voxel.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
 #include "glm/ext/matrix_transform.hpp"
 #include "prism/Components/Camera/CameraEditorController.h"
 #include "prism/Components/Camera/FPSCameraController.h"
+#include "prism/Benchmarking/MeasureChunkMeshing.h"
+#include "prism/Benchmarking/MeasureNoise.h"
+#include "prism/Benchmarking/MeasureQueues.h"
+#include "prism/Benchmarking/MeasureRaycasts.h"
+#include "prism/Benchmarking/MeasureThreadPool.h"
 #include "prism/System/ScopeTimer.h"
 
 using namespace Prism;
@@ -26,62 +37,109 @@ void WorldGen::OnAttach()
 	
 	m_Camera.AttachController<Renderer::FPSCameraController<Renderer::PerspectiveCamera>>();
 	m_Camera.GetController()->SetMoveSpeed(32);
-	m_Ctx->Assets.Shaders->LoadAsset("baseshader", { "res/voxel.vert", "res/voxel.frag" });
-	m_Shader = m_Ctx->Assets.Shaders->Get("baseshader");
-
-	m_Chunks = MakeVec<Voxel::Chunk>();
+	m_Ctx->Assets.Shaders->LoadAsset("baseshader", { "res/voxel_float.vert", "res/voxel.frag" });
+	m_Ctx->Assets.Shaders->LoadAsset("packedshader", { "res/voxel.vert", "res/voxel.frag" });
+	m_FloatShader = m_Ctx->Assets.Shaders->Get("baseshader");
+	m_PackedShader = m_Ctx->Assets.Shaders->Get("packedshader");
 
-	GenerateWorld(m_BlockSize, m_ChunkSize, 5, 5);
+	m_Streamer = MakePtr<Voxel::ChunkStreamer>(m_Ctx->Tasks->GetWorker("bg"));
+	m_HeightCache = MakeRef<Voxel::HeightCache>(static_cast<size_t>(m_HeightCacheMB) << 20);
+	GenerateWorld();
 
 	m_CameraLocked = true;
 }
 
-void WorldGen::GenerateWorld(int BlockSize, int ChunkSize, int ChunkXCount, int ChunkYCount)
+void WorldGen::GenerateWorld()
 {
 	m_IsGenerating = true;
 
+	// Settle the chunks of the previous source before switching,
+	// the jobs that haven't started are dropped instead of run
+	m_Streamer->Regenerate();
+	m_Streamer->WaitForJobs();
+
 	m_Noise.setScale(m_NoiseScale * m_NoiseMulti);
 	m_Noise.setXOffset(m_NoiseXOffset);
 	m_Noise.setYOffset(m_NoiseYOffset);
-	
-	m_Chunks->clear();
-	m_ChunkData.clear();
 
-	for (int i = 0; i < ChunkXCount * ChunkYCount; i++)
-	{
-		int bx = i % ChunkYCount;
-		int bz = (i / ChunkXCount) % ChunkYCount;
+	m_Shader = m_PackedVertices ? m_PackedShader : m_FloatShader;
 
-		m_Chunks->emplace_back(ChunkSize, BlockSize);
-		int last = m_Chunks->size() - 1;
+	Voxel::ChunkStreamer::Settings settings;
+	settings.ChunkSize = m_ChunkSize;
+	settings.BlockSize = m_BlockSize;
+	settings.Format = m_PackedVertices ? Voxel::Chunk::VertexFormat::PACKED : Voxel::Chunk::VertexFormat::FLOAT;
+	settings.Meshing = m_GreedyMeshing ? Voxel::Chunk::MeshingMode::GREEDY : Voxel::Chunk::MeshingMode::PERFACE;
+	settings.LoadRadius = m_LoadRadius;
+	settings.UnloadRadius = std::max(m_UnloadRadius, m_LoadRadius + 1);
+	settings.MaxJobsInFlight = m_MaxChunkJobs;
+	settings.MaxNewJobsPerUpdate = m_MaxChunkJobs;
+	settings.LodDistance = m_LodDistance;
+	settings.MaxLod = m_MaxLod;
 
-		auto s = m_Chunks->at(last).Size();
+	m_Streamer->Configure(settings);
 
-		m_ChunkData.push_back({ glm::vec3{ s.x, s.y, s.z } * glm::vec3(bx, 0.f, bz) });
-		m_Chunks->at(last).SetOffset(bx, bz);
-		m_Chunks->at(last).SetPopulationFunction([this](int x, int y)
-			{
-				auto noise = m_Noise.Fractal2(x, y);
-				return (noise + 1) / 2;
-			});
+	m_NoiseGraph = m_UseNoiseGraph ? Voxel::NoiseGraph::FromFile(m_NoiseGraphPath) : nullptr;
+	if (m_NoiseGraph)
+	{
+		m_HeightSource = m_NoiseGraph;
+		m_HeightParams = m_NoiseGraph->GetParams();
+	}
+	else
+	{
+		auto perlin = MakeRef<Voxel::PerlinHeightSource>(m_Noise);
+		m_HeightParams = perlin->GetParams();
+		m_HeightSource = perlin;
 	}
+	m_Streamer->SetHeightSource(m_HeightSource);
+	m_Streamer->SetHeightCache(m_HeightCache, m_HeightParams);
 
-	for (auto& chunk : *m_Chunks)
+	// A store is tied to one terrain, edits made so far are saved to the old one
+	const uint32_t stamp = WorldStamp();
+	if (!m_SaveChunks)
 	{
-		m_Ctx->Tasks->GetWorker("bg")->QueueTask([this, &chunk]()
-			{
-				chunk.Allocate();
-				chunk.Populate();
-				chunk.GenerateMesh();
-			});
+		m_Store.reset();
 	}
+	else if (!m_Store || m_Store->GetStamp() != stamp || m_Store->GetChunkSize() != m_ChunkSize)
+	{
+		m_Streamer->SetStore(nullptr);
+		m_Store = MakeRef<Voxel::RegionStore>(m_WorldDirectory, stamp, m_ChunkSize, m_Ctx->Tasks->GetWorker("io"));
+	}
+	m_Streamer->SetStore(m_Store);
+	m_Streamer->Regenerate();
 
 	m_IsGenerating = false;
 }
 
-void WorldGen::OnDetach()
+uint32_t WorldGen::WorldStamp() const
 {
+	auto Bits = [](float f)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &f, sizeof(bits));
+		return bits;
+	};
+
+	// FNV-1a over everything that feeds the population function, same set as HeightCache::KeyHash
+	const uint32_t Inputs[] = {
+		Bits(m_HeightParams.Scale), Bits(m_HeightParams.XOffset), Bits(m_HeightParams.YOffset),
+		m_HeightParams.Octaves, Bits(m_HeightParams.Persistence),
+		static_cast<uint32_t>(m_HeightParams.Graph), static_cast<uint32_t>(m_HeightParams.Graph >> 32)
+	};
+
+	uint32_t hash = 2166136261u;
+	auto bytes = reinterpret_cast<const uint8_t*>(Inputs);
+	for (size_t i = 0; i < sizeof(Inputs); i++)
+	{
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
 
+void WorldGen::OnDetach()
+{
+	// Saves the edited chunks before the store flushes its writes
+	m_Streamer.reset();
+	m_Store.reset();
 }
 
 void WorldGen::OnSystemEvent(Event& e)
@@ -105,6 +163,12 @@ void WorldGen::OnSystemEvent(Event& e)
 				m_Ctx->SystemOptions->EnableCursor();
 			}
 			break;
+		case Keyboard::F3:
+			m_DigRequested = true;
+			break;
+		case Keyboard::F4:
+			m_PlaceRequested = true;
+			break;
 		case Keyboard::LSHIFT:
 			m_MoveSpeedMultiplier = 2;
 			break;
@@ -132,6 +196,7 @@ void WorldGen::OnGuiDraw()
 	ImGui::MenuItem("Graphics", 0, &m_ShowBaseCtrls);
 	ImGui::MenuItem("World Generation", 0, &m_ShowChunkCtrls);
 	ImGui::MenuItem("Controls", 0, &m_ShowControls);
+	ImGui::MenuItem("Thread Pools", 0, &m_ShowThreadPools);
 	ImGui::EndMainMenuBar();
 
 	if (m_ShowControls)
@@ -143,8 +208,21 @@ void WorldGen::OnGuiDraw()
 		ImGui::SliderFloat("Camera Move Speed", &m_MoveSpeed, 0, 100);
 		ImGui::Text("Toggle Wireframe = F1");
 		ImGui::Text("Toggle Camera = F2");
+		ImGui::Text("Dig / Place at crosshair = F3 / F4");
+		ImGui::Separator();
+		m_Ctx->Tasks->ForEachWorker([](const std::string& name, const System::ThreadPool& pool)
+			{
+				auto stats = pool.GetStats();
+				ImGui::Text("%s: %zu threads, %zu pending, %llu run, %.0f%% busy", name.c_str(), stats.Workers, stats.Pending,
+					(unsigned long long)stats.TasksRun, stats.Utilisation * 100.0);
+			});
 		ImGui::End();
 	}
+
+	if (m_ShowThreadPools)
+	{
+		DrawThreadPools();
+	}
 	
 	if (m_ShowChunkCtrls)
 	{
@@ -155,9 +233,69 @@ void WorldGen::OnGuiDraw()
 		ImGui::SliderFloat("Noise Y Offset", &m_NoiseYOffset, 0, 10);
 		ImGui::SliderInt("Block Size", &m_BlockSize, 2, 16);
 		ImGui::SliderInt("Chunk Size", &m_ChunkSize, 8, 64);
-		ImGui::SliderInt("Chunk Count", &m_ChunkCount, 8, 128);
+		ImGui::SliderInt("Load Radius", &m_LoadRadius, 1, 32);
+		ImGui::SliderInt("Unload Radius", &m_UnloadRadius, 2, 40);
+		ImGui::SliderInt("Max Chunk Jobs", &m_MaxChunkJobs, 1, 64);
+		ImGui::SliderInt("LOD Distance", &m_LodDistance, 0, 16);
+		ImGui::SliderInt("Max LOD", &m_MaxLod, 0, 3);
+		ImGui::Checkbox("Greedy Meshing", &m_GreedyMeshing);
+		ImGui::Checkbox("Packed Vertices", &m_PackedVertices);
+		ImGui::Checkbox("Frustum Culling", &m_FrustumCulling);
+		ImGui::Checkbox("Save Chunks", &m_SaveChunks);
+		ImGui::Checkbox("Noise Graph", &m_UseNoiseGraph);
+		if (m_UseNoiseGraph)
+		{
+			ImGui::SameLine();
+			ImGui::Text("%s", m_NoiseGraph ? m_NoiseGraphPath.c_str() : "(not loaded)");
+		}
+		if (ImGui::SliderInt("Height Cache (MB)", &m_HeightCacheMB, 1, 256))
+		{
+			m_HeightCache->SetBudget(static_cast<size_t>(m_HeightCacheMB) << 20);
+		}
 		m_GenerateWorldBtn = ImGui::Button("Generate World");
-	
+		m_BenchmarkMeshingBtn = ImGui::Button("Benchmark Meshing");
+		m_BenchmarkRaycastsBtn = ImGui::Button("Benchmark Raycasts");
+		m_BenchmarkNoiseBtn = ImGui::Button("Benchmark Noise");
+		m_BenchmarkPoolBtn = ImGui::Button("Benchmark Thread Pools");
+		m_BenchmarkQueuesBtn = ImGui::Button("Benchmark Queues");
+
+		auto& stats = m_Streamer->GetStats();
+		auto center = m_Streamer->GetCenter();
+		ImGui::Separator();
+		ImGui::Text("Center Chunk: %d, %d", center.x, center.y);
+		ImGui::Text("Chunks Loaded: %d (%d ready)", stats.Loaded, stats.Ready);
+		ImGui::Text("Jobs In Flight: %d", stats.InFlight);
+		if (m_FrustumCulling)
+		{
+			ImGui::Text("Drawn: %d, Culled: %d", stats.Drawn, stats.Culled);
+		}
+		ImGui::Text("Pooled: %d, Retiring: %d", stats.Pooled, stats.Retiring);
+		ImGui::Text("Block Memory: %.2f MB", stats.BlockMemory / (1024.f * 1024.f));
+		ImGui::Text("Mesh Memory: %.2f MB", stats.MeshMemory / (1024.f * 1024.f));
+		ImGui::Text("Vertices: %zu", stats.Vertices);
+		ImGui::Text("Last Edit: %d chunks in %.3f ms", stats.EditedChunks, stats.EditNanoseconds / 1e6f);
+		ImGui::Text("Per LOD: %d / %d / %d / %d", stats.PerLod[0], stats.PerLod[1], stats.PerLod[2], stats.PerLod[3]);
+		if (stats.ScratchJobs > 0)
+		{
+			ImGui::Text("Job Scratch: %.1f KB arena, %.1f KB heap per job",
+				stats.ScratchArenaBytes / 1024.f / stats.ScratchJobs, stats.ScratchHeapBytes / 1024.f / stats.ScratchJobs);
+		}
+		if (m_NoiseGraph)
+		{
+			ImGui::Text("Noise Graph: %zu ops, %d registers", m_NoiseGraph->GetOpCount(), m_NoiseGraph->GetRegisterCount());
+		}
+		auto cacheStats = m_HeightCache->GetStats();
+		ImGui::Text("Height Cache: %zu hits, %zu misses, %zu evicted", cacheStats.Hits, cacheStats.Misses, cacheStats.Evictions);
+		ImGui::Text("Height Tiles: %zu (%.2f / %.2f MB)", cacheStats.Tiles,
+			cacheStats.Memory / (1024.f * 1024.f), cacheStats.Budget / (1024.f * 1024.f));
+		if (m_Store)
+		{
+			auto storeStats = m_Store->GetStats();
+			ImGui::Text("Regions: %d, Pending Writes: %d", storeStats.Regions, storeStats.PendingWrites);
+			ImGui::Text("Chunks Loaded From Disk: %zu, Saved: %zu (%.2f MB)",
+				storeStats.Loaded, storeStats.Saved, storeStats.BytesWritten / (1024.f * 1024.f));
+		}
+
 		ImGui::End();
 	}
 	
@@ -171,6 +309,55 @@ void WorldGen::OnGuiDraw()
 	}
 }
 
+void WorldGen::DrawThreadPools()
+{
+	// Log2 buckets as plotted, from 1 ns to over a second
+	auto plot = [](const char* label, const System::ThreadPool::Histogram& histogram)
+	{
+		float counts[System::ThreadPool::Histogram::Buckets];
+		for (size_t i = 0; i < System::ThreadPool::Histogram::Buckets; i++)
+		{
+			counts[i] = static_cast<float>(histogram.Counts[i]);
+		}
+		char overlay[64];
+		snprintf(overlay, sizeof(overlay), "p50 %.1f us, p99 %.1f us",
+			histogram.Percentile(0.5) / 1e3, histogram.Percentile(0.99) / 1e3);
+		ImGui::PlotHistogram(label, counts, static_cast<int>(System::ThreadPool::Histogram::Buckets), 0,
+			overlay, 0.f, FLT_MAX, ImVec2(0, 60));
+	};
+
+	ImGui::Begin("Thread Pools");
+	m_Ctx->Tasks->ForEachWorker([&plot](const std::string& name, const System::ThreadPool& pool)
+		{
+			auto stats = pool.GetStats();
+			if (!ImGui::CollapsingHeader(name.c_str(), ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				return;
+			}
+
+			ImGui::PushID(name.c_str());
+			const double uptime = std::max<double>(stats.UptimeNanoseconds * static_cast<double>(stats.Workers), 1.0);
+			ImGui::Text("%zu threads, %.0f%% busy, %.0f%% parked", stats.Workers,
+				stats.BusyNanoseconds * 100.0 / uptime, stats.ParkedNanoseconds * 100.0 / uptime);
+			ImGui::Text("Queued %llu, run %llu, cancelled %llu", (unsigned long long)stats.TasksQueued,
+				(unsigned long long)stats.TasksRun, (unsigned long long)stats.TasksCancelled);
+			ImGui::Text("Pending %zu, high-water %zu", stats.Pending, stats.PendingHighWater);
+			plot("Wait", stats.WaitTime);
+			plot("Run", stats.RunTime);
+
+			for (size_t i = 0; i < stats.PerWorker.size(); i++)
+			{
+				auto& worker = stats.PerWorker[i];
+				const double alive = std::max<double>(stats.UptimeNanoseconds, 1.0);
+				ImGui::Text("%s/%zu: %llu run, %llu queued, %llu cancelled, %.0f%% busy, %.0f%% parked", name.c_str(), i,
+					(unsigned long long)worker.TasksRun, (unsigned long long)worker.TasksQueued, (unsigned long long)worker.TasksCancelled,
+					worker.BusyNanoseconds * 100.0 / alive, worker.ParkedNanoseconds * 100.0 / alive);
+			}
+			ImGui::PopID();
+		});
+	ImGui::End();
+}
+
 void WorldGen::OnUpdate(float dt)
 {
 	m_Camera.GetController()->SetRotationSpeed(m_MouseSens);
@@ -182,9 +369,77 @@ void WorldGen::OnUpdate(float dt)
 	if (m_GenerateWorldBtn && !m_IsGenerating)
 	{
 		m_GenerateWorldBtn = false;
-		int size = (int) sqrt(m_ChunkCount);
-		GenerateWorld(m_BlockSize, m_ChunkSize, size, size);
+		GenerateWorld();
+	}
+
+	if (m_DigRequested || m_PlaceRequested)
+	{
+		EditAtCrosshair(m_PlaceRequested);
+		m_DigRequested = false;
+		m_PlaceRequested = false;
+	}
+
+	m_Streamer->Update(m_Camera.GetPosition());
+
+	if (m_BenchmarkRaycastsBtn)
+	{
+		m_BenchmarkRaycastsBtn = false;
+		MeasureRaycasts(m_Streamer->GetRaycaster(), m_Camera.GetPosition(), m_Ctx->Tasks->GetWorker("bg").get());
+	}
+
+	if (m_BenchmarkNoiseBtn)
+	{
+		m_BenchmarkNoiseBtn = false;
+		MeasureNoise(m_Noise);
+	}
+
+	if (m_BenchmarkMeshingBtn)
+	{
+		m_BenchmarkMeshingBtn = false;
+		MeasureChunkMeshing(*m_HeightSource, m_ChunkSize, m_BlockSize);
+	}
+
+	if (m_BenchmarkPoolBtn)
+	{
+		m_BenchmarkPoolBtn = false;
+		MeasureThreadPool(*m_HeightSource, m_ChunkSize, m_BlockSize);
 	}
+
+	if (m_BenchmarkQueuesBtn)
+	{
+		m_BenchmarkQueuesBtn = false;
+		MeasureQueues();
+	}
+}
+
+void WorldGen::EditAtCrosshair(bool place)
+{
+	Voxel::Ray ray;
+	ray.Origin = m_Camera.GetPosition();
+	ray.Direction = m_Camera.GetDirection();
+
+	auto hit = m_Streamer->GetRaycaster().Trace(ray);
+	if (!hit.Hit)
+	{
+		return;
+	}
+
+	auto block = hit.Block;
+	if (!place)
+	{
+		m_Streamer->SetBlock(block.x, block.y, block.z, Voxel::Chunk::BlockType::NONE);
+		return;
+	}
+
+	switch (hit.Face)
+	{
+	case Voxel::Chunk::Face::TOP: block.y++; break;
+	case Voxel::Chunk::Face::LEFT: block.x++; break;
+	case Voxel::Chunk::Face::RIGHT: block.x--; break;
+	case Voxel::Chunk::Face::FRONT: block.z++; break;
+	case Voxel::Chunk::Face::BACK: block.z--; break;
+	}
+	m_Streamer->SetBlock(block.x, block.y, block.z, Voxel::Chunk::BlockType::DIRT);
 }
 
 void WorldGen::OnDraw()
@@ -193,22 +448,26 @@ void WorldGen::OnDraw()
 	{
 		return;
 	}
-	glm::mat4 m(1.f);
-	for (int i = 0; i < m_Chunks->size(); i++)
+	m_Shader->Bind();
+	m_Shader->SetInt("tex", 0);
+	m_Shader->SetFloat3("lightPos", m_LightPosition);
+	m_Shader->SetFloat("lightIntens", m_LightIntensity);
+	m_Shader->SetFloat3("lightClr", m_LightClr);
+	m_Shader->SetMat4("projectedview", m_Camera.GetProjectedView());
+
+	auto DrawChunk = [this](Voxel::Chunk& chunk)
+	{
+		m_Shader->SetMat4("transform", chunk.GetTransform());
+		m_Shader->SetFloat("blockSize", chunk.GetBlockSize());
+		chunk.Render();
+	};
+
+	if (m_FrustumCulling)
+	{
+		m_Streamer->ForEachVisible(m_Camera.GetFrustum(), DrawChunk);
+	}
+	else
 	{
-		if (!m_Chunks->at(i).MeshReady())
-		{
-			continue;
-		}
-		
-		m_Chunks->at(i).SendToGpu();
-		m_Shader->Bind();
-		m_Shader->SetMat4("transform", glm::translate(m, m_ChunkData[i].offset));
-		m_Shader->SetInt("tex", 0);
-		m_Shader->SetFloat3("lightPos", m_LightPosition);
-		m_Shader->SetFloat("lightIntens", m_LightIntensity);
-		m_Shader->SetFloat3("lightClr", m_LightClr);
-		m_Shader->SetMat4("projectedview", m_Camera.GetProjectedView());
-		m_Chunks->at(i).Render();
+		m_Streamer->ForEachReady(DrawChunk);
 	}
 }
@@ -5,21 +5,19 @@
 #include "prism/Renderer/DynamicMesh.h"
 #include "prism/Renderer/PerspectiveCamera.h"
 #include "prism/Voxels/Chunk.h"
+#include "prism/Voxels/ChunkStreamer.h"
+#include "prism/Voxels/NoiseGraph.h"
+#include "prism/Voxels/PerlinHeightSource.h"
 
 using namespace Prism;
 
 class WorldGen : public ILayer
 {
 public:
-	struct ChunkData
-	{
-		glm::vec3 offset;
-	};
-	
 	WorldGen(Core::SharedContextRef ctx, const std::string& name);
 	virtual ~WorldGen();
 
-	void GenerateWorld(int BlockSize, int ChunkSize, int ChunkXCount, int ChunkYCount);
+	void GenerateWorld();
 	void OnAttach() override;
 	void OnDetach() override;
 	void OnDraw() override;
@@ -27,23 +25,51 @@ public:
 	void OnGuiDraw() override;
 	void OnUpdate(float dt) override;
 private:
+	// Digs the block under the crosshair or places one on the face it points at
+	void EditAtCrosshair(bool place);
+	void DrawThreadPools();
+	// Identifies the terrain the noise settings produce, stored chunks of another stamp are discarded
+	uint32_t WorldStamp() const;
+
 	std::future<void> m_MeshGen;
 	bool m_CursorOverGui{ false };
 
 	// Hardcoded width and height for now
 	Renderer::PerspectiveCamera m_Camera{ 90, 1280, 720, 0.1f, 2048.f };
 	Ref<Gl::Shader> m_Shader;
+	Ref<Gl::Shader> m_FloatShader;
+	Ref<Gl::Shader> m_PackedShader;
 	Math::PerlinNoise m_Noise;
-	VectorPtr<Voxel::Chunk> m_Chunks;
-	std::vector<ChunkData> m_ChunkData;
+	Ptr<Voxel::ChunkStreamer> m_Streamer;
+	Ref<Voxel::RegionStore> m_Store;
+	Ref<Voxel::HeightCache> m_HeightCache;
+	// Snapshot of m_Noise or the noise graph taken by GenerateWorld
+	Ref<const Voxel::IHeightSource> m_HeightSource;
+	Voxel::NoiseParams m_HeightParams;
+	Ref<Voxel::NoiseGraph> m_NoiseGraph;
+	std::string m_NoiseGraphPath{ "res/terrain.json" };
+	std::string m_WorldDirectory{ "worlds/default" };
 	bool m_CameraLocked{ true };
 	glm::vec3 m_LightPosition{ 0.f, -200.f, 200.f };
 	glm::vec3 m_LightClr{ 0.1f, 0.9f, 0.6f };
 	float m_LightIntensity{ 1.f };
 	bool m_IsGenerating{ false }; 
 	bool m_GenerateWorldBtn{ false };
+	bool m_BenchmarkMeshingBtn{ false };
+	bool m_BenchmarkRaycastsBtn{ false };
+	bool m_BenchmarkNoiseBtn{ false };
+	bool m_BenchmarkPoolBtn{ false };
+	bool m_BenchmarkQueuesBtn{ false };
+	bool m_DigRequested{ false };
+	bool m_PlaceRequested{ false };
+	bool m_GreedyMeshing{ true };
+	bool m_PackedVertices{ true };
+	bool m_FrustumCulling{ true };
+	bool m_SaveChunks{ true };
+	bool m_UseNoiseGraph{ false };
 	bool m_ShowChunkCtrls{ true };
 	bool m_ShowControls{ true };
+	bool m_ShowThreadPools{ false };
 	bool m_ShowBaseCtrls{ false };
 	bool m_ShowSystemControls{ false };
 	float m_NoiseMulti{ 1.f };
@@ -52,7 +78,12 @@ private:
 	float m_NoiseYOffset{ 0.f };
 	int m_BlockSize{ 4 };
 	int m_ChunkSize{ 32 };
-	int m_ChunkCount{ 25 };
+	int m_LoadRadius{ 6 };
+	int m_UnloadRadius{ 8 };
+	int m_MaxChunkJobs{ 8 };
+	int m_LodDistance{ 4 };
+	int m_MaxLod{ 3 };
+	int m_HeightCacheMB{ 32 };
 	float m_MouseSens{ 0.3 };
 	float m_MoveSpeed{ 35 };
 	int m_MoveSpeedMultiplier{ 1 };
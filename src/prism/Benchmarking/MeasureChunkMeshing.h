@@ -0,0 +1,53 @@
+#pragma once
+
+#include "prism/System/ScopeTimer.h"
+#include "prism/Voxels/Chunk.h"
+
+// Meshes the same terrain with every meshing mode and vertex format and
+// reports the produced geometry, its gpu size and the average mesh time.
+// Needs a current gl context, the chunks own their gpu buffers
+inline void MeasureChunkMeshing(const Prism::Voxel::IHeightSource& source, int ChunkSize = 32, int BlockSize = 4, int Runs = 20)
+{
+	using namespace Prism;
+	using Mode = Voxel::Chunk::MeshingMode;
+	using Format = Voxel::Chunk::VertexFormat;
+	using Clock = System::Time::Clock;
+
+	std::pair<Format, const char*> Formats[] = {
+		{ Format::FLOAT, "Float" },
+		{ Format::PACKED, "Packed" },
+	};
+	
+	std::pair<Mode, const char*> Modes[] = {
+		{ Mode::PERFACE, "PerFace" },
+		{ Mode::GREEDY, "Greedy" },
+	};
+
+	for (auto& [format, formatName] : Formats)
+	{
+		Voxel::Chunk chunk(ChunkSize, BlockSize, format);
+		chunk.Allocate();
+		chunk.Populate(source);
+		
+		for (auto& [mode, modeName] : Modes)
+		{
+			chunk.SetMeshingMode(mode);
+
+			auto start = Clock::now();
+			for (int i = 0; i < Runs; i++)
+			{
+				chunk.GenerateMesh();
+			}
+			auto elapsed = System::Time::DurationCast<System::Time::Nanoseconds>(Clock::now() - start);
+
+			PR_CORE_INFO("(Benchmark) Meshing {0} {1}\tvertices {2}\tindices {3}\t{4} bytes\t{5}us per mesh",
+				modeName,
+				formatName,
+				chunk.GetVertexCount(),
+				chunk.GetIndexCount(),
+				chunk.GetMeshMemorySize(),
+				elapsed / Runs / 1000
+			);
+		}
+	}
+}
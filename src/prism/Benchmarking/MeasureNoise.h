@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+
+#include "prism/Math/PerlinNoise.h"
+#include "prism/System/ScopeTimer.h"
+
+// Fills the same tile per sample and with every batched kernel the cpu
+// supports, reports the time per tile and checks the kernels match bit for bit
+inline void MeasureNoise(const Prism::Math::PerlinNoise& noise, int TileSize = 64, int Runs = 50)
+{
+	using namespace Prism;
+	using Kernel = Math::PerlinNoise::Kernel;
+	using Clock = System::Time::Clock;
+
+	const size_t count = static_cast<size_t>(TileSize) * TileSize;
+	std::vector<float> reference(count);
+	std::vector<float> tile(count);
+
+	auto start = Clock::now();
+	for (int i = 0; i < Runs; i++)
+	{
+		for (int y = 0; y < TileSize; y++)
+		{
+			for (int x = 0; x < TileSize; x++)
+			{
+				reference[y * TileSize + x] = noise.Fractal2(x + i, y);
+			}
+		}
+	}
+	auto elapsed = System::Time::DurationCast<System::Time::Nanoseconds>(Clock::now() - start);
+	PR_CORE_INFO("(Benchmark) Noise per sample\t{0}us per {1}x{1} tile", elapsed / Runs / 1000, TileSize);
+
+	std::pair<Kernel, const char*> Kernels[] = {
+		{ Kernel::SCALAR, "Scalar" },
+		{ Kernel::SSE41, "SSE4.1" },
+		{ Kernel::AVX2, "AVX2" },
+	};
+
+	for (auto& [kernel, name] : Kernels)
+	{
+		if (kernel > Math::PerlinNoise::BestKernel())
+		{
+			PR_CORE_INFO("(Benchmark) Noise {0}\tnot supported", name);
+			continue;
+		}
+
+		start = Clock::now();
+		for (int i = 0; i < Runs; i++)
+		{
+			noise.Fractal2Tile(tile.data(), i, 0, TileSize, TileSize, 1, kernel);
+		}
+		elapsed = System::Time::DurationCast<System::Time::Nanoseconds>(Clock::now() - start);
+
+		// The last run used the same offset as the reference
+		const bool identical = std::memcmp(tile.data(), reference.data(), count * sizeof(float)) == 0;
+		PR_CORE_INFO("(Benchmark) Noise {0}\t{1}us per {2}x{2} tile\t{3}",
+			name,
+			elapsed / Runs / 1000,
+			TileSize,
+			identical ? "identical" : "MISMATCH"
+		);
+	}
+}
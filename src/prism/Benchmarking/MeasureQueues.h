@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "prism/System/Log.h"
+#include "prism/System/ScopeTimer.h"
+#include "prism/Utils/BoundedQueue.h"
+#include "prism/Utils/SyncQueue.h"
+
+// Producers put Items values between them, every consumer stops on its
+// own sentinel, returns the items per second. The sentinels are used since
+// SyncQueue::Finish can reset before a sleeping consumer sees it. Sum is
+// set to the total of the values taken out to check nothing got lost
+template<typename Queue>
+inline double MeasureQueueThroughput(Queue& queue, int Producers, int Consumers, int Items, long long& Sum)
+{
+	using namespace Prism;
+	using Clock = System::Time::Clock;
+
+	std::atomic<long long> sum{ 0 };
+	std::vector<std::thread> threads;
+
+	auto start = Clock::now();
+	for (int c = 0; c < Consumers; c++)
+	{
+		threads.emplace_back([&queue, &sum]
+			{
+				long long local = 0;
+				int item;
+				while (queue.Get(item) && item >= 0)
+				{
+					local += item;
+				}
+				sum.fetch_add(local);
+			});
+	}
+
+	std::vector<std::thread> producers;
+	for (int p = 0; p < Producers; p++)
+	{
+		producers.emplace_back([&queue, p, Producers, Items]
+			{
+				for (int i = p; i < Items; i += Producers)
+				{
+					queue.Put(i);
+				}
+			});
+	}
+
+	for (auto& producer : producers)
+	{
+		producer.join();
+	}
+	for (int c = 0; c < Consumers; c++)
+	{
+		queue.Put(-1);
+	}
+	for (auto& consumer : threads)
+	{
+		consumer.join();
+	}
+
+	auto elapsed = System::Time::DurationCast<System::Time::Nanoseconds>(Clock::now() - start);
+	Sum = sum.load();
+	return Items * 1e9 / std::max<long long>(elapsed, 1);
+}
+
+// Hand off throughput of the mutex SyncQueue against the bounded lock free
+// queue, from one to four producers and consumers
+inline void MeasureQueues(int Items = 1000000, size_t Capacity = 1024)
+{
+	using namespace Prism;
+
+	const long long expected = static_cast<long long>(Items) * (Items - 1) / 2;
+	for (int threads : { 1, 2, 4 })
+	{
+		long long syncSum = 0;
+		long long boundedSum = 0;
+
+		Utils::SyncQueue<int> sync;
+		const double syncRate = MeasureQueueThroughput(sync, threads, threads, Items, syncSum);
+
+		Utils::BoundedQueue<int> bounded(Capacity);
+		const double boundedRate = MeasureQueueThroughput(bounded, threads, threads, Items, boundedSum);
+
+		PR_CORE_INFO("(Benchmark) Queues {0}x{0}\tsync {1:.0f}/s, bounded ({2}) {3:.0f}/s", threads, syncRate, bounded.Capacity(), boundedRate);
+		if (syncSum != expected || boundedSum != expected)
+		{
+			PR_CORE_ERROR("(Benchmark) Queues lost items: sync {0}, bounded {1}, expected {2}", syncSum, boundedSum, expected);
+		}
+	}
+}
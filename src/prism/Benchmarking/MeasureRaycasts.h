@@ -0,0 +1,59 @@
+#pragma once
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "prism/System/ScopeTimer.h"
+#include "prism/Voxels/Ray.h"
+
+// Casts RayCount rays from the origin in random directions over the lower
+// hemisphere and tilted up to 30 degrees above the horizon, first one by
+// one and then as a batch split over the pool, and reports rays per second
+inline void MeasureRaycasts(const Prism::Voxel::Raycaster& raycaster, const glm::vec3& origin, Prism::System::ThreadPool* pool, int RayCount = 1 << 16)
+{
+	using namespace Prism;
+	using Clock = System::Time::Clock;
+
+	std::mt19937 rng(1337);
+	std::uniform_real_distribution<float> angle(0.f, 2.f * static_cast<float>(M_PI));
+	std::uniform_real_distribution<float> height(-1.f, 0.5f);
+
+	std::vector<Voxel::Ray> rays(RayCount);
+	for (auto& ray : rays)
+	{
+		float a = angle(rng);
+		float y = height(rng);
+		float r = std::sqrt(1.f - y * y);
+		ray.Origin = origin;
+		ray.Direction = glm::vec3{ r * std::cos(a), y, r * std::sin(a) };
+	}
+
+	std::vector<Voxel::RayHit> hits(RayCount);
+
+	auto start = Clock::now();
+	for (int i = 0; i < RayCount; i++)
+	{
+		hits[i] = raycaster.Trace(rays[i]);
+	}
+	auto single = System::Time::DurationCast<System::Time::Nanoseconds>(Clock::now() - start);
+
+	start = Clock::now();
+	raycaster.TraceBatch(rays.data(), hits.data(), rays.size(), pool);
+	auto batched = System::Time::DurationCast<System::Time::Nanoseconds>(Clock::now() - start);
+
+	int hitCount = 0;
+	for (auto& hit : hits)
+	{
+		hitCount += hit.Hit;
+	}
+
+	PR_CORE_INFO("(Benchmark) Raycasts {0} rays, {1} hits\tsingle {2:.2f} Mrays/s\tbatched {3:.2f} Mrays/s",
+		RayCount,
+		hitCount,
+		RayCount * 1e3 / std::max<long long>(single, 1),
+		RayCount * 1e3 / std::max<long long>(batched, 1)
+	);
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "prism/System/MutexThreadPool.h"
+#include "prism/System/ScopeTimer.h"
+#include "prism/System/ThreadPool.h"
+#include "prism/Voxels/Chunk.h"
+
+// Queues Tasks empty tasks from this thread and waits for the last one,
+// returns the tasks per second
+template<typename Pool>
+inline double MeasurePoolEmptyTasks(size_t Threads, int Tasks)
+{
+	using namespace Prism;
+	using Clock = System::Time::Clock;
+
+	Pool pool;
+	pool.StartSync(Threads);
+
+	std::atomic<int> done{ 0 };
+	std::promise<void> finished;
+	auto start = Clock::now();
+	for (int i = 0; i < Tasks; i++)
+	{
+		// The futures are dropped, the counter tells when everything ran
+		pool.QueueTask([&done, &finished, Tasks]
+			{
+				if (done.fetch_add(1, std::memory_order_relaxed) + 1 == Tasks)
+				{
+					finished.set_value();
+				}
+			});
+	}
+	finished.get_future().wait();
+	auto elapsed = System::Time::DurationCast<System::Time::Nanoseconds>(Clock::now() - start);
+	return Tasks * 1e9 / std::max<long long>(elapsed, 1);
+}
+
+// Submits Tasks empty tasks fire and forget, from this thread or from one
+// task fanning out on a worker, after a warm up round that fills the free
+// lists. Returns the tasks per second, Allocations is set to the tasks the
+// measured round had to create
+inline double MeasurePoolSubmit(size_t Threads, int Tasks, bool FromWorker, uint64_t& Allocations)
+{
+	using namespace Prism;
+	using Clock = System::Time::Clock;
+
+	System::ThreadPool pool;
+	pool.StartSync(Threads);
+
+	auto round = [&pool, Tasks, FromWorker]
+	{
+		std::atomic<int> done{ 0 };
+		auto submit = [&pool, &done, Tasks]
+		{
+			for (int i = 0; i < Tasks; i++)
+			{
+				pool.Submit([&done] { done.fetch_add(1, std::memory_order_release); });
+			}
+		};
+
+		if (FromWorker)
+		{
+			pool.Submit(submit);
+		}
+		else
+		{
+			submit();
+		}
+		// Acquire so the next round can reuse the counter's stack slot
+		while (done.load(std::memory_order_acquire) < Tasks)
+		{
+			std::this_thread::yield();
+		}
+	};
+
+	round();
+	const uint64_t allocated = System::ThreadPool::TasksAllocated();
+	auto start = Clock::now();
+	round();
+	auto elapsed = System::Time::DurationCast<System::Time::Nanoseconds>(Clock::now() - start);
+	Allocations = System::ThreadPool::TasksAllocated() - allocated;
+	return Tasks * 1e9 / std::max<long long>(elapsed, 1);
+}
+
+// Populates and meshes the chunks on the pool, returns the chunks per second.
+// The chunks are created by the caller since they own gl buffers
+template<typename Pool>
+inline double MeasurePoolChunkJobs(size_t Threads, std::vector<Prism::Ptr<Prism::Voxel::Chunk>>& Chunks, const Prism::Voxel::IHeightSource& source)
+{
+	using namespace Prism;
+	using Clock = System::Time::Clock;
+
+	Pool pool;
+	pool.StartSync(Threads);
+
+	std::vector<std::future<void>> jobs;
+	jobs.reserve(Chunks.size());
+	auto start = Clock::now();
+	for (auto& chunk : Chunks)
+	{
+		jobs.push_back(pool.QueueTask([chunk = chunk.get(), &source]
+			{
+				chunk->Allocate();
+				chunk->Populate(source);
+				chunk->GenerateMesh();
+			}));
+	}
+	for (auto& job : jobs)
+	{
+		job.wait();
+	}
+	auto elapsed = System::Time::DurationCast<System::Time::Nanoseconds>(Clock::now() - start);
+	return Chunks.size() * 1e9 / std::max<long long>(elapsed, 1);
+}
+
+// Throughput of the mutex pool against the work stealing pool at 1 to 16
+// threads, on empty tasks (pure scheduling overhead) and on chunk jobs.
+// Empty tasks are also submitted without futures on the work stealing pool
+inline void MeasureThreadPool(const Prism::Voxel::IHeightSource& source, int ChunkSize = 32, int BlockSize = 4, int EmptyTasks = 200000, int ChunkJobs = 256)
+{
+	using namespace Prism;
+
+	std::vector<Ptr<Voxel::Chunk>> chunks;
+	for (int i = 0; i < ChunkJobs; i++)
+	{
+		chunks.push_back(MakePtr<Voxel::Chunk>(ChunkSize, BlockSize, Voxel::Chunk::VertexFormat::PACKED));
+		chunks.back()->SetOffset(i % 16, i / 16);
+	}
+
+	for (size_t threads : { 1, 2, 4, 8, 16 })
+	{
+		PR_CORE_INFO("(Benchmark) Pool {0} threads\tempty tasks: mutex {1:.0f}/s, stealing {2:.0f}/s",
+			threads,
+			MeasurePoolEmptyTasks<System::MutexThreadPool>(threads, EmptyTasks),
+			MeasurePoolEmptyTasks<System::ThreadPool>(threads, EmptyTasks)
+		);
+
+		uint64_t externalAllocations = 0;
+		uint64_t workerAllocations = 0;
+		const double external = MeasurePoolSubmit(threads, EmptyTasks, false, externalAllocations);
+		const double worker = MeasurePoolSubmit(threads, EmptyTasks, true, workerAllocations);
+		PR_CORE_INFO("(Benchmark) Pool {0} threads\tsubmit: external {1:.0f}/s ({2} allocations), from a worker {3:.0f}/s ({4} allocations)",
+			threads, external, externalAllocations, worker, workerAllocations
+		);
+
+		PR_CORE_INFO("(Benchmark) Pool {0} threads\tchunk jobs: mutex {1:.1f}/s, stealing {2:.1f}/s",
+			threads,
+			MeasurePoolChunkJobs<System::MutexThreadPool>(threads, chunks, source),
+			MeasurePoolChunkJobs<System::ThreadPool>(threads, chunks, source)
+		);
+	}
+}
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <thread>
+
 #include "IAssetLoader.h"
+#include "prism/System/MainThreadQueue.h"
+#include "prism/System/Task.h"
 #include "prism/System/ThreadPool.h"
 
 namespace Prism::Core
@@ -26,11 +30,13 @@ namespace Prism::Core
 		{	
 		}
 
-		AssetLoader(const std::string& name, Ref<System::ThreadPool> queue)
+		// queue runs the loads on a thread with a shared gl context, mainQueue publishes them
+		AssetLoader(const std::string& name, Ref<System::ThreadPool> queue, Ref<System::MainThreadQueue> mainQueue)
 			:
 			IAssetLoader<T, LoadArgs>(),
 			m_Name(name),
-			m_TaskQueue(std::move(queue))
+			m_TaskQueue(std::move(queue)),
+			m_MainQueue(std::move(mainQueue))
 		{
 		}
 
@@ -52,10 +58,15 @@ namespace Prism::Core
 			return _LoadFunc();
 		}
 
+		// Assets show up on the main thread once the gpu is done with their uploads
 		void AsyncLoad() override
 		{
-			m_LoadingAsync = true;
-			m_LoadTask = m_TaskQueue->QueueTask([this] { _LoadFunc(); });
+			PR_ASSERT(m_TaskQueue && m_MainQueue, "(Assets) Async loading needs a task and a main queue");
+			Wait();
+
+			m_LoadTask = _LoadAsync(std::move(m_QueuedLoad));
+			m_QueuedLoad.clear();
+			m_LoadTask.Start();
 		}
 
 		float GetProgress() override
@@ -84,6 +95,7 @@ namespace Prism::Core
 		// Will search only if all assets are loading if not will force sync load on assets
 		Ref<T> MustGet(const std::string& name) override
 		{
+			Wait();
 			if (m_QueuedLoad.size() != 0)
 			{
 				SyncLoad();
@@ -97,13 +109,22 @@ namespace Prism::Core
 			return nullptr;
 		}
 
+		// Main thread only, runs the main queue until the async load is published
 		void Wait()
 		{
-			if (m_LoadTask.valid())
+			if (!m_LoadTask.IsValid())
+			{
+				return;
+			}
+
+			while (!m_LoadTask.IsDone())
 			{
-				m_LoadTask.wait();
-				m_LoadTask = {};
+				if (m_MainQueue->RunPending() == 0)
+				{
+					std::this_thread::yield();
+				}
 			}
+			m_LoadTask = {};
 		}
 		
 		void ClearLoaded() override
@@ -193,24 +214,77 @@ namespace Prism::Core
 			PR_CORE_INFO("Assets ({0})\tFinished Loading", m_Name);
 			m_LoadingTaskStarted = false;
 			
-			if (m_LoadingAsync)
+			return false;
+		}
+
+		// Loads on the loading context, then publishes on the main thread
+		System::Task<bool> _LoadAsync(std::vector<std::pair<std::string, LoadArgs>> queued)
+		{
+			co_await System::ResumeOn(*m_TaskQueue);
 			{
-				glFinish();
-				m_LoadingAsync = false;
+				std::lock_guard<std::mutex> g(m_M);
+				m_UnloadedAssetCount = static_cast<int>(queued.size());
+				m_LoadedAssetCount = 0;
+				m_LoadingTaskStarted = true;
 			}
-			
-			return false;
+
+			bool err = false;
+			std::vector<std::pair<std::string, Ref<T>>> loaded;
+			for (auto& [Name, Args] : queued)
+			{
+				PR_CORE_INFO("Assets ({0})\t(Loading)\t{1}", m_Name, Name);
+				auto [LoadedAsset, failed] = LoadFunc(Args);
+				if (failed)
+				{
+					PR_CORE_ERROR("Assets ({0})\tError loading asset:{1}", m_Name, Name);
+					err = true;
+					break;
+				}
+				loaded.emplace_back(Name, std::move(LoadedAsset));
+
+				std::lock_guard<std::mutex> g(m_M);
+				m_LoadedAssetCount++;
+			}
+
+			// Signals once the uploads above are visible to the main context
+			GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glFlush();
+
+			// Polled once per frame instead of blocking either thread
+			co_await System::ResumeOn(*m_MainQueue);
+			while (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				co_await System::ResumeOn(*m_MainQueue);
+			}
+			glDeleteSync(fence);
+
+			for (auto& [Name, Asset] : loaded)
+			{
+				if (!m_Assets.emplace(Name, std::move(Asset)).second)
+				{
+					PR_CORE_ERROR("Assets ({0})\tAsset already loaded:{1}", m_Name, Name);
+					PR_CONST_ASSERT(!ShouldAssert, "Asset already loaded: " + Name);
+				}
+			}
+
+			PR_CORE_INFO("Assets ({0})\tFinished Loading", m_Name);
+			m_LoadingTaskStarted = false;
+			if (err)
+			{
+				PR_CONST_ASSERT(!ShouldAssert, "Error loading asset");
+			}
+			co_return err;
 		}
 		
 		std::mutex m_M;
 		std::unordered_map<std::string, Ref<T>> m_Assets;
 		std::vector<std::pair<std::string, LoadArgs>> m_QueuedLoad;
 		std::string m_Name;
-		System::TaskFuture m_LoadTask{};
-		bool m_LoadingAsync{ false };
+		System::Task<bool> m_LoadTask;
 		bool m_LoadingTaskStarted{ false };
 		int m_UnloadedAssetCount{ 0 };
 		int m_LoadedAssetCount{ 0 };
 		Ref<System::ThreadPool> m_TaskQueue;
+		Ref<System::MainThreadQueue> m_MainQueue;
 	};
 }
@@ -1,8 +1,14 @@
 #include "BackgroundTasks.h"
 
+#include <algorithm>
+
+#include "prism/System/Thread.h"
+
 namespace Prism::Core
 {
 	BackgroundTasks::BackgroundTasks()
+		:
+		m_MainQueue(MakeRef<System::MainThreadQueue>())
 	{
 		
 	}
@@ -12,28 +18,40 @@ namespace Prism::Core
 		Finish();
 	}
 	
-	void BackgroundTasks::RegisterWorker(const std::string& name, int count)
+	void BackgroundTasks::RegisterWorker(const std::string& name, const WorkerOptions& options)
 	{
-		auto p = MakeRef<System::ThreadPool>();
-		p->Start();
-		PR_CORE_WARN("(BackgroundTasks) Regisering worker {0}", name);
+		PR_ASSERT(options.Count > 0, "(BackgroundTasks) Worker needs at least one thread");
+
+		auto p = MakeRef<System::ThreadPool>(options.StartCallback, options.EndCallback);
+		p->SetName(name);
+		p->SetAffinity(options.Pin, options.FirstCore);
+		p->Start(options.Count);
+		PR_CORE_WARN("(BackgroundTasks) Registering worker {0} with {1} threads", name, options.Count);
 		m_Workers.emplace(name, std::move(p));
 	}
 
+	void BackgroundTasks::RegisterWorker(const std::string& name, int count)
+	{
+		WorkerOptions options;
+		options.Count = count;
+		RegisterWorker(name, options);
+	}
+
 	void BackgroundTasks::RegisterWorker(const std::string& name, int count, System::VoidCallback StartCallback)
 	{
-		auto p = MakeRef<System::ThreadPool>(StartCallback);
-		p->Start();
-		PR_CORE_WARN("(BackgroundTasks) Regisering worker {0}", name);
-		m_Workers.emplace(name, std::move(p));
+		WorkerOptions options;
+		options.Count = count;
+		options.StartCallback = std::move(StartCallback);
+		RegisterWorker(name, options);
 	}
 
 	void BackgroundTasks::RegisterWorker(const std::string& name, int count, System::VoidCallback StartCallback, System::VoidCallback EndCallback)
 	{
-		auto p = MakeRef<System::ThreadPool>(StartCallback, EndCallback);
-		p->Start(count);
-		PR_CORE_WARN("(BackgroundTasks) Regisering worker {0}", name);
-		m_Workers.emplace(name, std::move(p));
+		WorkerOptions options;
+		options.Count = count;
+		options.StartCallback = std::move(StartCallback);
+		options.EndCallback = std::move(EndCallback);
+		RegisterWorker(name, options);
 	}
 
 	Ref<System::ThreadPool> BackgroundTasks::GetWorker(const std::string& name)
@@ -47,6 +65,39 @@ namespace Prism::Core
 		return nullptr;
 	}
 
+	void BackgroundTasks::ForEachWorker(const std::function<void(const std::string&, const System::ThreadPool&)>& func) const
+	{
+		for (auto& [name, pool] : m_Workers)
+		{
+			func(name, *pool);
+		}
+	}
+
+	int BackgroundTasks::HardwareWorkers(int reserved)
+	{
+		return std::max(System::HardwareThreads() - reserved, 1);
+	}
+
+	size_t BackgroundTasks::RunMainThreadTasks()
+	{
+		return m_MainQueue->RunPending();
+	}
+
+	Ref<System::TaskGraph> BackgroundTasks::CreateGraph(const std::string& worker)
+	{
+		return MakeRef<System::TaskGraph>(GetWorker(worker), m_MainQueue);
+	}
+
+	System::ScheduleOnPool BackgroundTasks::ResumeOn(const std::string& worker)
+	{
+		return System::ResumeOn(*GetWorker(worker));
+	}
+
+	System::ScheduleOnQueue BackgroundTasks::ResumeOnMain()
+	{
+		return System::ResumeOn(*m_MainQueue);
+	}
+
 	void BackgroundTasks::Finish()
 	{
 		for (auto& itr : m_Workers)
@@ -1,9 +1,14 @@
-#pragma one
+#pragma once
 
+#include <functional>
+#include <map>
 #include <string>
 #include <vector>
 
 #include "Pointers.h"
+#include "prism/System/MainThreadQueue.h"
+#include "prism/System/Task.h"
+#include "prism/System/TaskGraph.h"
 #include "prism/System/ThreadPool.h"
 
 namespace Prism::Core
@@ -11,16 +16,41 @@ namespace Prism::Core
 	class BackgroundTasks
 	{
 	public:
+		struct WorkerOptions
+		{
+			int Count{ 1 };
+			// Worker i runs on core (FirstCore + i) % cores
+			bool Pin{ false };
+			int FirstCore{ 0 };
+			System::VoidCallback StartCallback;
+			System::VoidCallback EndCallback;
+		};
+
 		BackgroundTasks();
 		~BackgroundTasks();
+		void RegisterWorker(const std::string& name, const WorkerOptions& options);
 		void RegisterWorker(const std::string& name, int count);
 		void RegisterWorker(const std::string& name, int count, System::VoidCallback StartCallback);
 		void RegisterWorker(const std::string& name, int count, System::VoidCallback StartCallback, System::VoidCallback EndCallback);
 		Ref<System::ThreadPool> GetWorker(const std::string& name);
+		void ForEachWorker(const std::function<void(const std::string&, const System::ThreadPool&)>& func) const;
+
+		// Every core but the reserved ones, at least one
+		static int HardwareWorkers(int reserved);
+		// Work for the thread running the frame loop, drained once per frame
+		Ref<System::MainThreadQueue> GetMainQueue() const { return m_MainQueue; }
+		size_t RunMainThreadTasks();
+		// Graph running its worker nodes on the named pool and its main nodes on the main queue
+		Ref<System::TaskGraph> CreateGraph(const std::string& worker);
+		// co_await in a System::Task to continue on the named pool or the main thread
+		System::ScheduleOnPool ResumeOn(const std::string& worker);
+		System::ScheduleOnQueue ResumeOnMain();
 
 		void Finish();
 		void Abort();
 	private:
-		std::unordered_map<std::string, Ref<System::ThreadPool>> m_Workers;
+		// Ordered so the pools are listed the same way every frame
+		std::map<std::string, Ref<System::ThreadPool>> m_Workers;
+		Ref<System::MainThreadQueue> m_MainQueue;
 	};
 }
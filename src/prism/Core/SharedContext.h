@@ -53,10 +53,13 @@ namespace Prism::Core
 			glFinish();
 		});
 
-		ctx->Tasks->RegisterWorker("bg", 4);
+		// The main thread and the loading context keep a core each
+		ctx->Tasks->RegisterWorker("bg", BackgroundTasks::HardwareWorkers(2));
+		// Disk writes, kept off "bg" so they never hold up generation
+		ctx->Tasks->RegisterWorker("io", 1);
 		
-		ctx->Assets.Textures = MakeRef<TextureAssets>("Textures", ctx->Tasks->GetWorker(SHARECTX_TASKNAME));
-		ctx->Assets.Shaders = MakeRef<ShaderAssets>("Shaders", ctx->Tasks->GetWorker(SHARECTX_TASKNAME));
+		ctx->Assets.Textures = MakeRef<TextureAssets>("Textures", ctx->Tasks->GetWorker(SHARECTX_TASKNAME), ctx->Tasks->GetMainQueue());
+		ctx->Assets.Shaders = MakeRef<ShaderAssets>("Shaders", ctx->Tasks->GetWorker(SHARECTX_TASKNAME), ctx->Tasks->GetMainQueue());
 		
 		return ctx;
 	}	
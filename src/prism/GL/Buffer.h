@@ -13,6 +13,7 @@ namespace Prism::Gl
 		Int2,
 		Int3,
 		Int4,
+		UInt,
 		Float,
 		Float2,
 		Float3,
@@ -30,6 +31,7 @@ namespace Prism::Gl
 		case ShaderDataType::Int2:		return 4 * 2;
 		case ShaderDataType::Int3:		return 4 * 3;
 		case ShaderDataType::Int4:		return 4 * 4;
+		case ShaderDataType::UInt:		return 4;
 		case ShaderDataType::Float:		return 4;
 		case ShaderDataType::Float2:	return 4 * 2;
 		case ShaderDataType::Float3:	return 4 * 3;
@@ -70,6 +72,7 @@ namespace Prism::Gl
 			case ShaderDataType::Int2:    return 2;
 			case ShaderDataType::Int3:    return 3;
 			case ShaderDataType::Int4:    return 4;
+			case ShaderDataType::UInt:    return 1;
 			case ShaderDataType::Bool:    return 1;
 			}
 
@@ -54,6 +54,18 @@ namespace Prism::Gl
 				m_BufferIndex++;
 				break;
 			}
+			// Passed through untouched, read as uint/uvec in the shader
+			case ShaderDataType::UInt:
+			{
+				glVertexAttribIPointer(m_BufferIndex,
+					element.GetComponentCount(),
+					OpenGLBaseType(element.Type),
+					layout.GetStride(),
+					(const void*)element.Offset);
+				glEnableVertexAttribArray(m_BufferIndex);
+				m_BufferIndex++;
+				break;
+			}
 			case ShaderDataType::Mat3:
 			case ShaderDataType::Mat4:
 			{
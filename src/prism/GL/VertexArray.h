@@ -23,6 +23,7 @@ namespace Prism::Gl
 			case ShaderDataType::Int2:     return GL_INT;
 			case ShaderDataType::Int3:     return GL_INT;
 			case ShaderDataType::Int4:     return GL_INT;
+			case ShaderDataType::UInt:     return GL_UNSIGNED_INT;
 			case ShaderDataType::Bool:     return GL_BOOL;
 		}
 
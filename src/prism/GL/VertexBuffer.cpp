@@ -80,9 +80,11 @@ namespace Prism::Gl
 		glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_DYNAMIC_DRAW);
 	}
 
-	void VertexBuffer::UpdateSubData(float* vertices, size_t size)
+	void VertexBuffer::UpdateSubData(const void* data, size_t offset, size_t size)
 	{
-		// Todo: Finish this
+		if (!m_Dynamic || size == 0) return;
+		Bind();
+		glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
 	}
 	
 	void VertexBuffer::Bind() const
@@ -25,7 +25,8 @@ namespace Prism::Gl
 		const BufferLayout& GetLayout() { return m_Layout; };
 
 		void SetData(float* vertices, size_t size);
-		void UpdateSubData(float* vertices, size_t size);
+		// Offset and size are in bytes, the buffer has to be big enough already
+		void UpdateSubData(const void* data, size_t offset, size_t size);
 
 		template<typename T>
 		void SetData(std::vector<T>& vertices, size_t count)
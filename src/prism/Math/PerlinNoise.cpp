@@ -48,7 +48,7 @@ namespace Prism::Math
 		m_scale *= s;
 	}
 
-	prdecimal PerlinNoise::Perlin2(prdecimal x, prdecimal y)
+	prdecimal PerlinNoise::Perlin2(prdecimal x, prdecimal y) const
 	{
 		int X = static_cast<int>(floor(x)) & 255,
 			Y = static_cast<int>(floor(y)) & 255;
@@ -68,7 +68,7 @@ namespace Prism::Math
 				grad(p[BB], x - 1, y - 1, 0)));
 	}
 
-	prdecimal PerlinNoise::Perlin3(prdecimal x, prdecimal y, prdecimal z)
+	prdecimal PerlinNoise::Perlin3(prdecimal x, prdecimal y, prdecimal z) const
 	{
 		int X = static_cast<int>(floor(x)) & 255,
 			Y = static_cast<int>(floor(y)) & 255,
@@ -95,7 +95,7 @@ namespace Prism::Math
 					grad(p[BB + 1], x - 1, y - 1, z - 1))));
 	}
 
-	prdecimal PerlinNoise::Fractal2(prdecimal x, prdecimal y)
+	prdecimal PerlinNoise::Fractal2(prdecimal x, prdecimal y) const
 	{
 		prdecimal total = 0;
 		prdecimal freq = 0;
@@ -115,7 +115,7 @@ namespace Prism::Math
 		return total;
 	}
 
-	prdecimal PerlinNoise::Fractal3(prdecimal x, prdecimal y, prdecimal z)
+	prdecimal PerlinNoise::Fractal3(prdecimal x, prdecimal y, prdecimal z) const
 	{
 		prdecimal total = 0;
 		prdecimal freq = 0;
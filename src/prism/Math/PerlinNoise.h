@@ -11,11 +11,25 @@ namespace Prism::Math
 	{
 	public:
 		PerlinNoise(unsigned int octaves = 5, float persistence = 0.5);
-		prdecimal Perlin2(prdecimal x, prdecimal y);
-		prdecimal Perlin3(prdecimal x, prdecimal y, prdecimal z);
+		prdecimal Perlin2(prdecimal x, prdecimal y) const;
+		prdecimal Perlin3(prdecimal x, prdecimal y, prdecimal z) const;
 
-		prdecimal Fractal2(prdecimal x, prdecimal y);
-		prdecimal Fractal3(prdecimal x, prdecimal y, prdecimal z);
+		prdecimal Fractal2(prdecimal x, prdecimal y) const;
+		prdecimal Fractal3(prdecimal x, prdecimal y, prdecimal z) const;
+
+		enum class Kernel
+		{
+			SCALAR,
+			SSE41,
+			AVX2
+		};
+
+		// Fills out[y * w + x] with Fractal2(x0 + x * step, y0 + y * step), bit
+		// identical to calling it per sample. Uses the widest kernel the cpu supports
+		void Fractal2Tile(float* out, int x0, int y0, int w, int h, int step = 1) const;
+		// Falls back to the best supported kernel when kernel isn't available
+		void Fractal2Tile(float* out, int x0, int y0, int w, int h, int step, Kernel kernel) const;
+		static Kernel BestKernel();
 
 		void offsetX(prdecimal x);
 		void offsetY(prdecimal y);
@@ -28,6 +42,12 @@ namespace Prism::Math
 		void setScale(prdecimal s);
 		void offsetScale(prdecimal s);
 
+		prdecimal getXOffset() const { return m_offsetX; }
+		prdecimal getYOffset() const { return m_offsetY; }
+		prdecimal getScale() const { return m_scale; }
+		unsigned getOctaves() const { return m_octaves; }
+		prdecimal getPersistence() const { return m_persistence; }
+
 	private:
 		prdecimal m_offsetX{ 0 };
 		prdecimal m_offsetY{ 0 };
@@ -46,14 +66,14 @@ namespace Prism::Math
 			return  a * (1 - f) + b * f;
 		}
 
-		prdecimal grad(int hash, prdecimal x, prdecimal y, prdecimal z)
+		static prdecimal grad(int hash, prdecimal x, prdecimal y, prdecimal z)
 		{
 			int h = hash & 15;
 			prdecimal u = h < 8 ? x : y, v = h < 4 ? y : h == 12 || h == 14 ? x : z;
 			return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
 		}
 
-		prdecimal grad(int hash, prdecimal x, prdecimal y)
+		static prdecimal grad(int hash, prdecimal x, prdecimal y)
 		{
 			int h = hash & 15;
 			prdecimal u = h < 8 ? x : y, v = h < 4 ? y : h == 12 || h == 14 ? x : 0;
@@ -0,0 +1,257 @@
+#include "PerlinNoise.h"
+
+#include <algorithm>
+
+#include "prism/System/CpuFeatures.h"
+#include "prism/Utils/ScratchArena.h"
+
+#ifdef PR_X86
+#include <immintrin.h>
+#endif
+
+// Batched Fractal2. Everything that only depends on the column or the row
+// (lattice cell, fractional part, fade) is computed once per octave with the
+// exact scalar expressions, the kernels only do the hashing, gradients and
+// lerps per sample. Kernels multiply and add separately so no fma contraction
+// can change the result compared to Perlin2
+
+namespace Prism::Math
+{
+	namespace
+	{
+		struct ColumnTable
+		{
+			Utils::ScratchVector<int> PX, PX1;
+			Utils::ScratchVector<float> XF, XM1, U;
+
+			ColumnTable(int w)
+				:
+				PX(w), PX1(w), XF(w), XM1(w), U(w)
+			{}
+		};
+
+		struct RowValues
+		{
+			int Y;
+			float YF, YM1, V;
+			float Amplitude;
+		};
+
+#ifdef PR_X86
+		PR_TARGET("sse4.1") inline __m128 GradSse(__m128i hash, __m128 x, __m128 y)
+		{
+			const __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+			const __m128 lt8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+			const __m128 lt4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+			const __m128 useX = _mm_castsi128_ps(_mm_or_si128(
+				_mm_cmpeq_epi32(h, _mm_set1_epi32(12)),
+				_mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+			const __m128 flipU = _mm_castsi128_ps(_mm_slli_epi32(h, 31));
+			const __m128 flipV = _mm_castsi128_ps(_mm_slli_epi32(_mm_srli_epi32(h, 1), 31));
+
+			__m128 u = _mm_blendv_ps(y, x, lt8);
+			__m128 v = _mm_blendv_ps(_mm_blendv_ps(_mm_setzero_ps(), x, useX), y, lt4);
+			u = _mm_xor_ps(u, flipU);
+			v = _mm_xor_ps(v, flipV);
+			return _mm_add_ps(u, v);
+		}
+
+		PR_TARGET("sse4.1") inline __m128 LerpSse(__m128 t, __m128 a, __m128 b)
+		{
+			return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+		}
+
+		// Returns the number of columns handled, the rest is left to the scalar path
+		PR_TARGET("sse4.1") int RowSse41(const int* p, const ColumnTable& cols, const RowValues& row, float* out, int w)
+		{
+			const __m128 yf = _mm_set1_ps(row.YF);
+			const __m128 ym1 = _mm_set1_ps(row.YM1);
+			const __m128 v = _mm_set1_ps(row.V);
+			const __m128 amplitude = _mm_set1_ps(row.Amplitude);
+
+			int c = 0;
+			for (; c + 4 <= w; c += 4)
+			{
+				// No gathers before avx2, the permutation lookups stay scalar
+				alignas(16) int h00[4], h10[4], h01[4], h11[4];
+				for (int l = 0; l < 4; l++)
+				{
+					const int A = cols.PX[c + l] + row.Y, B = cols.PX1[c + l] + row.Y;
+					h00[l] = p[p[A]];
+					h01[l] = p[p[A + 1]];
+					h10[l] = p[p[B]];
+					h11[l] = p[p[B + 1]];
+				}
+
+				const __m128 xf = _mm_loadu_ps(&cols.XF[c]);
+				const __m128 xm1 = _mm_loadu_ps(&cols.XM1[c]);
+				const __m128 u = _mm_loadu_ps(&cols.U[c]);
+
+				const __m128 g00 = GradSse(_mm_load_si128(reinterpret_cast<const __m128i*>(h00)), xf, yf);
+				const __m128 g10 = GradSse(_mm_load_si128(reinterpret_cast<const __m128i*>(h10)), xm1, yf);
+				const __m128 g01 = GradSse(_mm_load_si128(reinterpret_cast<const __m128i*>(h01)), xf, ym1);
+				const __m128 g11 = GradSse(_mm_load_si128(reinterpret_cast<const __m128i*>(h11)), xm1, ym1);
+
+				const __m128 n = LerpSse(v, LerpSse(u, g00, g10), LerpSse(u, g01, g11));
+				_mm_storeu_ps(out + c, _mm_add_ps(_mm_loadu_ps(out + c), _mm_mul_ps(n, amplitude)));
+			}
+			return c;
+		}
+
+		PR_TARGET("avx2") inline __m256 GradAvx2(__m256i hash, __m256 x, __m256 y)
+		{
+			const __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+			const __m256 lt8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+			const __m256 lt4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+			const __m256 useX = _mm256_castsi256_ps(_mm256_or_si256(
+				_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)),
+				_mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+			const __m256 flipU = _mm256_castsi256_ps(_mm256_slli_epi32(h, 31));
+			const __m256 flipV = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_srli_epi32(h, 1), 31));
+
+			__m256 u = _mm256_blendv_ps(y, x, lt8);
+			__m256 v = _mm256_blendv_ps(_mm256_blendv_ps(_mm256_setzero_ps(), x, useX), y, lt4);
+			u = _mm256_xor_ps(u, flipU);
+			v = _mm256_xor_ps(v, flipV);
+			return _mm256_add_ps(u, v);
+		}
+
+		PR_TARGET("avx2") inline __m256 LerpAvx2(__m256 t, __m256 a, __m256 b)
+		{
+			return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+		}
+
+		PR_TARGET("avx2") int RowAvx2(const int* p, const ColumnTable& cols, const RowValues& row, float* out, int w)
+		{
+			const __m256i y = _mm256_set1_epi32(row.Y);
+			const __m256i one = _mm256_set1_epi32(1);
+			const __m256 yf = _mm256_set1_ps(row.YF);
+			const __m256 ym1 = _mm256_set1_ps(row.YM1);
+			const __m256 v = _mm256_set1_ps(row.V);
+			const __m256 amplitude = _mm256_set1_ps(row.Amplitude);
+
+			int c = 0;
+			for (; c + 8 <= w; c += 8)
+			{
+				// Indices stay below 512, p is duplicated for exactly that
+				const __m256i A = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&cols.PX[c])), y);
+				const __m256i B = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&cols.PX1[c])), y);
+
+				const __m256i h00 = _mm256_i32gather_epi32(p, _mm256_i32gather_epi32(p, A, 4), 4);
+				const __m256i h01 = _mm256_i32gather_epi32(p, _mm256_i32gather_epi32(p, _mm256_add_epi32(A, one), 4), 4);
+				const __m256i h10 = _mm256_i32gather_epi32(p, _mm256_i32gather_epi32(p, B, 4), 4);
+				const __m256i h11 = _mm256_i32gather_epi32(p, _mm256_i32gather_epi32(p, _mm256_add_epi32(B, one), 4), 4);
+
+				const __m256 xf = _mm256_loadu_ps(&cols.XF[c]);
+				const __m256 xm1 = _mm256_loadu_ps(&cols.XM1[c]);
+				const __m256 u = _mm256_loadu_ps(&cols.U[c]);
+
+				const __m256 g00 = GradAvx2(h00, xf, yf);
+				const __m256 g10 = GradAvx2(h10, xm1, yf);
+				const __m256 g01 = GradAvx2(h01, xf, ym1);
+				const __m256 g11 = GradAvx2(h11, xm1, ym1);
+
+				const __m256 n = LerpAvx2(v, LerpAvx2(u, g00, g10), LerpAvx2(u, g01, g11));
+				_mm256_storeu_ps(out + c, _mm256_add_ps(_mm256_loadu_ps(out + c), _mm256_mul_ps(n, amplitude)));
+			}
+			return c;
+		}
+#endif
+	}
+
+	void PerlinNoise::Fractal2Tile(float* out, int x0, int y0, int w, int h, int step) const
+	{
+		Fractal2Tile(out, x0, y0, w, h, step, BestKernel());
+	}
+
+	void PerlinNoise::Fractal2Tile(float* out, int x0, int y0, int w, int h, int step, Kernel kernel) const
+	{
+#ifdef PR_MATH_DOUBLES
+		// The kernels are single precision only
+		for (int y = 0; y < h; y++)
+		{
+			for (int x = 0; x < w; x++)
+			{
+				out[y * w + x] = static_cast<float>(Fractal2(x0 + x * step, y0 + y * step));
+			}
+		}
+#else
+		kernel = std::min(kernel, BestKernel());
+		std::fill(out, out + static_cast<size_t>(w) * h, 0.f);
+
+		Utils::ScratchScope scope;
+		ColumnTable cols(w);
+		for (unsigned int i = 0; i < m_octaves - 1; i++)
+		{
+			// Same expressions as Fractal2 and Perlin2, hoisted out of the sample loop
+			const prdecimal freq = pow(2, i);
+			const prdecimal amplitude = pow(m_persistence, i);
+
+			for (int c = 0; c < w; c++)
+			{
+				const prdecimal x = static_cast<prdecimal>(x0 + c * step);
+				prdecimal sx = (m_scale * (x + static_cast<double>(m_offsetX))) * freq;
+				const int X = static_cast<int>(floor(sx)) & 255;
+				sx -= floor(sx);
+
+				cols.PX[c] = p[X];
+				cols.PX1[c] = p[X + 1];
+				cols.XF[c] = sx;
+				cols.XM1[c] = sx - 1;
+				cols.U[c] = fade(sx);
+			}
+
+			for (int r = 0; r < h; r++)
+			{
+				const prdecimal y = static_cast<prdecimal>(y0 + r * step);
+				prdecimal sy = (m_scale * (y + static_cast<double>(m_offsetY))) * freq;
+				const int Y = static_cast<int>(floor(sy)) & 255;
+				sy -= floor(sy);
+
+				const RowValues row{ Y, sy, sy - 1, fade(sy), amplitude };
+				float* rowOut = out + static_cast<size_t>(r) * w;
+
+				int c = 0;
+#ifdef PR_X86
+				if (kernel == Kernel::AVX2)
+				{
+					c = RowAvx2(p, cols, row, rowOut, w);
+				}
+				else if (kernel == Kernel::SSE41)
+				{
+					c = RowSse41(p, cols, row, rowOut, w);
+				}
+#endif
+				for (; c < w; c++)
+				{
+					const int A = cols.PX[c] + Y, AA = p[A], AB = p[A + 1],
+						B = cols.PX1[c] + Y, BA = p[B], BB = p[B + 1];
+
+					const prdecimal n = lerp(row.V, lerp(cols.U[c], grad(p[AA], cols.XF[c], row.YF, 0),
+						grad(p[BA], cols.XM1[c], row.YF, 0)),
+						lerp(cols.U[c], grad(p[AB], cols.XF[c], row.YM1, 0),
+							grad(p[BB], cols.XM1[c], row.YM1, 0)));
+
+					rowOut[c] += n * amplitude;
+				}
+			}
+		}
+#endif
+	}
+
+	PerlinNoise::Kernel PerlinNoise::BestKernel()
+	{
+		[[maybe_unused]] const auto& cpu = System::CpuFeatures::Get();
+#ifdef PR_X86
+		if (cpu.AVX2)
+		{
+			return Kernel::AVX2;
+		}
+		if (cpu.SSE41)
+		{
+			return Kernel::SSE41;
+		}
+#endif
+		return Kernel::SCALAR;
+	}
+}
@@ -93,6 +93,7 @@ namespace Prism
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 			m_Context->Window->ProcessEvents();
+			m_Context->Tasks->RunMainThreadTasks();
 			
 			if (dt > m_FixedDt)
 			{
@@ -49,14 +49,14 @@ namespace Prism::Renderer
 		//m_IdxBuffer = std::move(idxBuff);
 	}
 
-	void DynamicMesh::AddVertexData(uint32_t vertIdx, std::vector<float>& data)
+	void DynamicMesh::AddVertexData(uint32_t vertIdx, const std::vector<float>& data)
 	{
 		m_VertexData[vertIdx].insert(m_VertexData[vertIdx].end(), data.begin(), data.end());
 
 		m_VertCount += data.size() / m_VertexBuffers[vertIdx]->GetLayout().GetLength();
 	}
 
-	void DynamicMesh::AddVertexData(std::vector<float>& data)
+	void DynamicMesh::AddVertexData(const std::vector<float>& data)
 	{
 		AddVertexData(0, data);
 	}
@@ -107,6 +107,7 @@ namespace Prism::Renderer
 	void DynamicMesh::NewMesh()
 	{
 		ClearBuffers();
+		m_VertCount = 0;
 		m_ElementCount = 0;
 	}
 	
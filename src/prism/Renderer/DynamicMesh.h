@@ -26,8 +26,8 @@ namespace Prism::Renderer
 		void AllocateIndexData(size_t size);
 		void SetIndexBuffer(Ref<Gl::IndexBuffer>);
 		
-		void AddVertexData(uint32_t vertIdx, std::vector<float>& data);
-		void AddVertexData(std::vector<float>& data);
+		void AddVertexData(uint32_t vertIdx, const std::vector<float>& data);
+		void AddVertexData(const std::vector<float>& data);
 		
 		const std::vector<float>& GetVertexData(uint32_t vertIdx = 0)
 		{
@@ -40,6 +40,16 @@ namespace Prism::Renderer
 		{
 			return m_IndexData;
 		}
+
+		uint32_t GetVertexCount() const
+		{
+			return m_VertCount;
+		}
+
+		uint32_t GetElementCount() const
+		{
+			return m_ElementCount;
+		}
 		
 		template<typename T>
 		uint32_t AddVertex(uint32_t idx, const T& vert)
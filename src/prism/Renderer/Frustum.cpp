@@ -0,0 +1,82 @@
+#include "Frustum.h"
+
+#include <algorithm>
+
+namespace Prism::Renderer
+{
+	Frustum Frustum::FromMatrix(const glm::mat4& m)
+	{
+		// glm is column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+		auto Row = [&m](int i) { return glm::vec4{ m[0][i], m[1][i], m[2][i], m[3][i] }; };
+		const glm::vec4 r0 = Row(0);
+		const glm::vec4 r1 = Row(1);
+		const glm::vec4 r2 = Row(2);
+		const glm::vec4 r3 = Row(3);
+
+		Frustum f;
+		f.Planes[LEFT] = r3 + r0;
+		f.Planes[RIGHT] = r3 - r0;
+		f.Planes[BOTTOM] = r3 + r1;
+		f.Planes[TOP] = r3 - r1;
+		f.Planes[NEAR_CLIP] = r3 + r2;
+		f.Planes[FAR_CLIP] = r3 - r2;
+
+		for (auto& plane : f.Planes)
+		{
+			plane /= glm::length(glm::vec3{ plane.x, plane.y, plane.z });
+		}
+
+		return f;
+	}
+
+	void FrustumCuller::Clear()
+	{
+		m_MinX.clear(); m_MinY.clear(); m_MinZ.clear();
+		m_MaxX.clear(); m_MaxY.clear(); m_MaxZ.clear();
+		m_Visible.clear();
+	}
+
+	void FrustumCuller::Reserve(size_t count)
+	{
+		m_MinX.reserve(count); m_MinY.reserve(count); m_MinZ.reserve(count);
+		m_MaxX.reserve(count); m_MaxY.reserve(count); m_MaxZ.reserve(count);
+		m_Visible.reserve(count);
+	}
+
+	size_t FrustumCuller::AddBox(const glm::vec3& min, const glm::vec3& max)
+	{
+		m_MinX.push_back(min.x); m_MinY.push_back(min.y); m_MinZ.push_back(min.z);
+		m_MaxX.push_back(max.x); m_MaxY.push_back(max.y); m_MaxZ.push_back(max.z);
+		m_Visible.push_back(1);
+		return m_MinX.size() - 1;
+	}
+
+	size_t FrustumCuller::Cull(const Frustum& frustum)
+	{
+		const size_t count = m_MinX.size();
+		std::fill(m_Visible.begin(), m_Visible.end(), 1);
+
+		for (auto& plane : frustum.Planes)
+		{
+			// The corner furthest along the plane normal, picked once per plane
+			// instead of per box
+			const float* xs = plane.x >= 0.f ? m_MaxX.data() : m_MinX.data();
+			const float* ys = plane.y >= 0.f ? m_MaxY.data() : m_MinY.data();
+			const float* zs = plane.z >= 0.f ? m_MaxZ.data() : m_MinZ.data();
+			uint8_t* visible = m_Visible.data();
+
+			for (size_t i = 0; i < count; i++)
+			{
+				const float d = plane.x * xs[i] + plane.y * ys[i] + plane.z * zs[i] + plane.w;
+				visible[i] &= static_cast<uint8_t>(d >= 0.f);
+			}
+		}
+
+		size_t visibleCount = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			visibleCount += m_Visible[i];
+		}
+		return visibleCount;
+	}
+}
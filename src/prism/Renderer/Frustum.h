@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Prism::Renderer
+{
+	// Planes point inwards, a point p is inside when dot(plane.xyz, p) + plane.w >= 0
+	struct Frustum
+	{
+		enum Plane
+		{
+			LEFT = 0,
+			RIGHT,
+			BOTTOM,
+			TOP,
+			NEAR_CLIP,
+			FAR_CLIP,
+
+			COUNT
+		};
+
+		glm::vec4 Planes[COUNT];
+
+		// Gribb/Hartmann extraction from a projection * view matrix
+		static Frustum FromMatrix(const glm::mat4& projectedView);
+	};
+
+	// Tests a batch of axis aligned boxes against a frustum. Boxes are kept
+	// as separate min/max streams so the inner loop is branch free
+	class FrustumCuller
+	{
+	public:
+		void Clear();
+		void Reserve(size_t count);
+		// Returns the index of the box
+		size_t AddBox(const glm::vec3& min, const glm::vec3& max);
+		// Fills the visibility flags, returns the number of visible boxes
+		size_t Cull(const Frustum& frustum);
+
+		bool IsVisible(size_t index) const
+		{
+			return m_Visible[index] != 0;
+		}
+
+		size_t Size() const
+		{
+			return m_MinX.size();
+		}
+	private:
+		std::vector<float> m_MinX, m_MinY, m_MinZ;
+		std::vector<float> m_MaxX, m_MaxY, m_MaxZ;
+		std::vector<uint8_t> m_Visible;
+	};
+}
@@ -0,0 +1,113 @@
+#include "PackedQuadMesh.h"
+
+namespace Prism::Renderer
+{
+	Ref<Gl::IndexBuffer> PackedQuadMesh::s_QuadIndices;
+	uint32_t PackedQuadMesh::s_QuadIndexCapacity{ 0 };
+
+	PackedQuadMesh::PackedQuadMesh()
+		:
+		m_VertArray(MakePtr<Gl::VertexArray>())
+	{
+		ReserveSharedIndices(1024);
+		m_VertArray->SetIndexBuffer(s_QuadIndices);
+		
+		m_VertexBuffer = Gl::VertexBuffer::CreateRef({
+			{ Gl::ShaderDataType::UInt, "packed" }
+		});
+		m_VertArray->AddVertexBuffer(m_VertexBuffer);
+	}
+
+	void PackedQuadMesh::ReserveSharedIndices(uint32_t quadCount)
+	{
+		if (!s_QuadIndices)
+		{
+			s_QuadIndices = Gl::IndexBuffer::CreateRef();
+		}
+		
+		if (quadCount <= s_QuadIndexCapacity)
+		{
+			return;
+		}
+
+		// Grow in powers of two so resizes stay rare, the buffer id doesn't
+		// change so every vertex array bound to it picks up the new data
+		uint32_t capacity = s_QuadIndexCapacity ? s_QuadIndexCapacity : 1024;
+		while (capacity < quadCount)
+		{
+			capacity <<= 1;
+		}
+		
+		std::vector<uint32_t> indices;
+		indices.reserve(capacity * 6);
+		for (uint32_t q = 0; q < capacity; q++)
+		{
+			uint32_t v = q * 4;
+			indices.push_back(v);
+			indices.push_back(v + 1);
+			indices.push_back(v + 3);
+			indices.push_back(v + 3);
+			indices.push_back(v + 1);
+			indices.push_back(v + 2);
+		}
+		
+		s_QuadIndices->SetData(indices, indices.size());
+		s_QuadIndexCapacity = capacity;
+	}
+
+	void PackedQuadMesh::Flush()
+	{
+		m_DrawQuadCount = m_QuadCount;
+		if (m_QuadCount == 0)
+		{
+			return;
+		}
+		
+		ReserveSharedIndices(m_QuadCount);
+		m_VertexBuffer->SetData(m_VertexData, m_VertexData.size());
+	}
+
+	void PackedQuadMesh::FlushRange(uint32_t firstQuad, uint32_t quadCount)
+	{
+		PR_ASSERT(m_QuadCount == m_DrawQuadCount, "(PackedQuadMesh) Range flush after the quad count changed");
+		PR_ASSERT(firstQuad + quadCount <= m_QuadCount, "(PackedQuadMesh) Range flush out of bounds");
+		
+		constexpr size_t QuadBytes = 4 * sizeof(uint32_t);
+		m_VertexBuffer->UpdateSubData(GetQuad(firstQuad), firstQuad * QuadBytes, quadCount * QuadBytes);
+	}
+
+	void PackedQuadMesh::NewMesh()
+	{
+		ClearBuffers();
+		m_QuadCount = 0;
+	}
+
+	void PackedQuadMesh::ClearBuffers()
+	{
+		m_VertexData.clear();
+	}
+
+	void PackedQuadMesh::ClearGpuBuffers()
+	{
+		m_VertexBuffer->Clear();
+		m_DrawQuadCount = 0;
+	}
+
+	void PackedQuadMesh::DrawIndexed() const
+	{
+		if (m_DrawQuadCount == 0)
+		{
+			return;
+		}
+		
+		m_VertArray->Bind();
+		glDrawElements(GL_TRIANGLES, m_DrawQuadCount * 6, GL_UNSIGNED_INT, 0);
+	}
+
+	void PackedQuadMesh::DrawArrays() const
+	{
+		// Every quad needs 6 vertices without the index buffer, only useful for debugging
+		m_VertArray->Bind();
+		glDrawArrays(GL_TRIANGLES, 0, m_DrawQuadCount * 4);
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "prism/GL/VertexArray.h"
+#include "prism/GL/VertexBuffer.h"
+#include "prism/GL/IndexBuffer.h"
+#include "prism/Core/Pointers.h"
+#include "prism/Components/IMesh.h"
+
+namespace Prism::Renderer
+{
+	// Mesh made only out of quads where every vertex is a single
+	// 32 bit word, the layout of the word is up to the shader.
+	// Quads always connect the same way (v0 v1 v3, v3 v1 v2) so every
+	// mesh draws from one shared index buffer instead of uploading its own
+	class PackedQuadMesh : public IMesh
+	{
+	public:
+		PackedQuadMesh();
+
+		uint32_t AddQuad(uint32_t v0, uint32_t v1, uint32_t v2, uint32_t v3)
+		{
+			m_VertexData.push_back(v0);
+			m_VertexData.push_back(v1);
+			m_VertexData.push_back(v2);
+			m_VertexData.push_back(v3);
+			return m_QuadCount++;
+		}
+
+		const std::vector<uint32_t>& GetVertexData() const
+		{
+			return m_VertexData;
+		}
+
+		// The 4 words of a quad, valid until the next AddQuad
+		uint32_t* GetQuad(uint32_t quad)
+		{
+			return m_VertexData.data() + quad * 4;
+		}
+
+		// Drops quads past quadCount, or pads with zeroed (degenerate) quads
+		void ResizeQuads(uint32_t quadCount)
+		{
+			m_VertexData.resize(quadCount * 4, 0);
+			m_QuadCount = quadCount;
+		}
+
+		void SetVertexData(std::vector<uint32_t>&& data)
+		{
+			m_VertexData = std::move(data);
+			m_QuadCount = m_VertexData.size() / 4;
+		}
+
+		uint32_t GetVertexCount() const
+		{
+			return m_QuadCount * 4;
+		}
+
+		uint32_t GetElementCount() const
+		{
+			return m_QuadCount * 6;
+		}
+
+		uint32_t GetQuadCount() const
+		{
+			return m_QuadCount;
+		}
+
+		// Bytes the mesh takes on the gpu, the shared index buffer is not counted
+		size_t GetMemorySize() const
+		{
+			return m_VertexData.size() * sizeof(uint32_t);
+		}
+		
+		void Flush();
+		// Uploads only [firstQuad, firstQuad + quadCount), the quad count
+		// has to match the last Flush
+		void FlushRange(uint32_t firstQuad, uint32_t quadCount);
+		void NewMesh();
+		void ClearBuffers();
+		void ClearGpuBuffers();
+
+		void DrawIndexed() const override;
+		void DrawArrays() const override;
+
+		// Grows the shared index buffer to fit quadCount quads, lets a batch
+		// of uploads grow it once. Has to be called from the thread owning the gl context
+		static void ReserveSharedIndices(uint32_t quadCount);
+	private:
+
+		static Ref<Gl::IndexBuffer> s_QuadIndices;
+		static uint32_t s_QuadIndexCapacity;
+
+		std::vector<uint32_t> m_VertexData;
+		uint32_t m_QuadCount{ 0 };
+		uint32_t m_DrawQuadCount{ 0 }; // Quads on the gpu, in case the cpu side gets cleared
+		
+		Ref<Gl::VertexBuffer> m_VertexBuffer;
+		Ptr<Gl::VertexArray> m_VertArray;
+	};
+}
@@ -5,6 +5,7 @@
 #include "prism/Components/Camera/ICamera.h"
 #include "prism/Components/Camera/IController.h"
 #include "prism/Core/Pointers.h"
+#include "prism/Renderer/Frustum.h"
 #include "prism/System/Debug.h"
 
 namespace Prism::Renderer
@@ -40,6 +41,11 @@ namespace Prism::Renderer
 		{
 			return m_Position;
 		}
+
+		const glm::vec3& GetDirection() const
+		{
+			return m_Direction;
+		}
 		
 		const std::unique_ptr<ICameraController>& GetController()
 		{
@@ -66,6 +72,7 @@ namespace Prism::Renderer
 		const glm::mat4& GetProjectedView() const { return m_ProjectedView; }
 		const glm::mat4& GetProjection() const { return m_Projection; }
 		const glm::mat4& GetView() const { return m_View; }
+		Frustum GetFrustum() const { return Frustum::FromMatrix(m_ProjectedView); }
 	private:
 
 		void _RotateCamera();
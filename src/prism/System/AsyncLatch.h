@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+
+namespace Prism::System
+{
+	// Single use countdown one coroutine can await. The waiter is resumed
+	// inline by the thread making the last CountDown, a waiter that wants
+	// to go on elsewhere hops with ResumeOn afterwards
+	class AsyncLatch
+	{
+	public:
+		explicit AsyncLatch(int count = 0)
+		{
+			Reset(count);
+		}
+
+		AsyncLatch(const AsyncLatch&) = delete;
+		AsyncLatch& operator=(const AsyncLatch&) = delete;
+
+		// Only while nobody counts down or waits
+		void Reset(int count)
+		{
+			// One extra for the waiter, whoever takes the last one resumes it
+			m_Remaining.store(count + 1, std::memory_order_relaxed);
+			m_Waiter = nullptr;
+		}
+
+		void CountDown()
+		{
+			if (m_Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				m_Waiter.resume();
+			}
+		}
+
+		bool IsReady() const
+		{
+			return m_Remaining.load(std::memory_order_acquire) <= 1;
+		}
+
+		bool await_ready() const noexcept
+		{
+			return IsReady();
+		}
+
+		bool await_suspend(std::coroutine_handle<> waiter) noexcept
+		{
+			m_Waiter = waiter;
+			// Everyone counted down meanwhile, go on without suspending
+			return m_Remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+		}
+
+		void await_resume() const noexcept {}
+	private:
+		std::atomic<int> m_Remaining{ 1 };
+		std::coroutine_handle<> m_Waiter;
+	};
+}
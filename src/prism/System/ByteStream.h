@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace Prism::System
+{
+	// Little endian writer with LEB128 varints, signed values are zigzag encoded
+	class ByteWriter
+	{
+	public:
+		ByteWriter(std::vector<uint8_t>& out)
+			:
+			m_Out(out)
+		{}
+
+		void U8(uint8_t v)
+		{
+			m_Out.push_back(v);
+		}
+
+		void U32(uint32_t v)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				m_Out.push_back(static_cast<uint8_t>(v >> (i * 8)));
+			}
+		}
+
+		void VarU(uint64_t v)
+		{
+			while (v >= 0x80)
+			{
+				m_Out.push_back(static_cast<uint8_t>(v) | 0x80);
+				v >>= 7;
+			}
+			m_Out.push_back(static_cast<uint8_t>(v));
+		}
+
+		void VarI(int64_t v)
+		{
+			VarU((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+		}
+
+		size_t Size() const
+		{
+			return m_Out.size();
+		}
+	private:
+		std::vector<uint8_t>& m_Out;
+	};
+
+	// Reads what ByteWriter wrote, running past the end sets the failed flag
+	// and returns zeroes instead of reading out of bounds
+	class ByteReader
+	{
+	public:
+		ByteReader(const uint8_t* data, size_t size)
+			:
+			m_Data(data),
+			m_Size(size)
+		{}
+
+		uint8_t U8()
+		{
+			if (m_Pos >= m_Size)
+			{
+				m_Failed = true;
+				return 0;
+			}
+			return m_Data[m_Pos++];
+		}
+
+		uint32_t U32()
+		{
+			uint32_t v = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				v |= static_cast<uint32_t>(U8()) << (i * 8);
+			}
+			return v;
+		}
+
+		uint64_t VarU()
+		{
+			uint64_t v = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				uint8_t byte = U8();
+				v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+				if (!(byte & 0x80))
+				{
+					return v;
+				}
+			}
+			m_Failed = true;
+			return 0;
+		}
+
+		int64_t VarI()
+		{
+			uint64_t v = VarU();
+			return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+		}
+
+		bool Failed() const
+		{
+			return m_Failed;
+		}
+
+		bool AtEnd() const
+		{
+			return m_Pos == m_Size;
+		}
+
+		size_t Remaining() const
+		{
+			return m_Size - m_Pos;
+		}
+	private:
+		const uint8_t* m_Data;
+		size_t m_Size;
+		size_t m_Pos{ 0 };
+		bool m_Failed{ false };
+	};
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+
+#include "prism/Core/Pointers.h"
+
+namespace Prism::System
+{
+	// Shared flag a task checks to stop early, copies observe the same flag.
+	// A default constructed token can never be cancelled
+	class CancellationToken
+	{
+	public:
+		CancellationToken() = default;
+
+		static CancellationToken Create()
+		{
+			CancellationToken token;
+			token.m_Cancelled = MakeRef<std::atomic<bool>>(false);
+			return token;
+		}
+
+		void Cancel() const
+		{
+			if (m_Cancelled)
+			{
+				m_Cancelled->store(true, std::memory_order_relaxed);
+			}
+		}
+
+		bool IsCancelled() const
+		{
+			return m_Cancelled && m_Cancelled->load(std::memory_order_relaxed);
+		}
+	private:
+		Ref<std::atomic<bool>> m_Cancelled;
+	};
+}
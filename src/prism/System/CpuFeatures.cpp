@@ -0,0 +1,75 @@
+#include "CpuFeatures.h"
+
+#ifdef PR_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace Prism::System
+{
+#ifdef PR_X86
+	static void Cpuid(int leaf, int sub, unsigned regs[4])
+	{
+#ifdef _MSC_VER
+		int r[4];
+		__cpuidex(r, leaf, sub);
+		for (int i = 0; i < 4; i++)
+		{
+			regs[i] = static_cast<unsigned>(r[i]);
+		}
+#else
+		__cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	}
+
+	static unsigned long long Xgetbv()
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned lo, hi;
+		__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+		return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+	}
+
+	static CpuFeatures Detect()
+	{
+		CpuFeatures features;
+
+		unsigned regs[4];
+		Cpuid(0, 0, regs);
+		const unsigned maxLeaf = regs[0];
+		if (maxLeaf < 1)
+		{
+			return features;
+		}
+
+		Cpuid(1, 0, regs);
+		features.SSE41 = regs[2] & (1u << 19);
+		const bool osxsave = regs[2] & (1u << 27);
+		const bool avx = regs[2] & (1u << 28);
+
+		if (maxLeaf >= 7 && osxsave && avx && (Xgetbv() & 0x6) == 0x6)
+		{
+			Cpuid(7, 0, regs);
+			features.AVX2 = regs[1] & (1u << 5);
+		}
+		return features;
+	}
+#else
+	static CpuFeatures Detect()
+	{
+		return CpuFeatures{};
+	}
+#endif
+
+	const CpuFeatures& CpuFeatures::Get()
+	{
+		static const CpuFeatures features = Detect();
+		return features;
+	}
+}
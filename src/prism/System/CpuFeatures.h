@@ -0,0 +1,26 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PR_X86 1
+#endif
+
+// Lets a single function use instructions the rest of the build is not
+// compiled for, MSVC allows intrinsics everywhere so it needs nothing
+#if defined(PR_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PR_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PR_TARGET(isa)
+#endif
+
+namespace Prism::System
+{
+	// Instruction sets usable on this machine, queried once through cpuid
+	struct CpuFeatures
+	{
+		bool SSE41{ false };
+		// Includes the os saving the ymm registers
+		bool AVX2{ false };
+
+		static const CpuFeatures& Get();
+	};
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include "Types.h"
+
+namespace Prism::System
+{
+	// Work posted from any thread that has to run on the thread owning the
+	// gl context, the owner drains it once per frame and while it waits on jobs
+	class MainThreadQueue
+	{
+	public:
+		void Post(VoidCallback task)
+		{
+			std::lock_guard<std::mutex> lck(m_Mutex);
+			m_Tasks.push_back(std::move(task));
+		}
+
+		// Runs everything posted so far, tasks posted meanwhile wait for the
+		// next call. Returns the number of tasks run
+		size_t RunPending()
+		{
+			// Swapped out so a task can wait on jobs and drain again
+			std::vector<VoidCallback> running;
+			{
+				std::lock_guard<std::mutex> lck(m_Mutex);
+				if (m_Tasks.empty())
+				{
+					return 0;
+				}
+				running.swap(m_Tasks);
+			}
+
+			for (auto& task : running)
+			{
+				task();
+			}
+			return running.size();
+		}
+	private:
+		std::mutex m_Mutex;
+		std::vector<VoidCallback> m_Tasks;
+	};
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace Prism::System
+{
+	// Read only memory mapping of a whole file. The mapping covers the file
+	// size at the time of Open, map again to see data appended after that
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::string& filepath);
+		void Close();
+
+		const uint8_t* Data() const
+		{
+			return m_Data;
+		}
+
+		size_t Size() const
+		{
+			return m_Size;
+		}
+
+		bool IsOpen() const
+		{
+			return m_Data != nullptr;
+		}
+	private:
+		const uint8_t* m_Data{ nullptr };
+		size_t m_Size{ 0 };
+#ifdef _WIN32
+		void* m_File{ nullptr };
+		void* m_Mapping{ nullptr };
+#endif
+	};
+}
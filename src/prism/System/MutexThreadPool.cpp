@@ -0,0 +1,124 @@
+#include "MutexThreadPool.h"
+
+namespace Prism::System
+{
+	MutexThreadPool::MutexThreadPool()
+	{
+	}
+
+	MutexThreadPool::MutexThreadPool(VoidCallback StartCallback)
+		:
+		m_StartCallback(std::move(StartCallback))
+	{}
+
+	MutexThreadPool::MutexThreadPool(VoidCallback StartCallback, VoidCallback EndCallback)
+		:
+		m_StartCallback(std::move(StartCallback)),
+		m_EndCallback(std::move(EndCallback))
+	{}
+
+	MutexThreadPool::~MutexThreadPool()
+	{
+		Finish();
+	}
+
+	void MutexThreadPool::Start(size_t N)
+	{
+		for (size_t i = 0; i < N; i++)
+		{
+			m_RunningThreads.push_back(
+				std::async(
+					std::launch::async,
+					[this] { _ThreadWork();  }
+			));
+		}
+	}
+
+	void MutexThreadPool::StartSync(size_t N)
+	{
+		for (size_t i = 0; i < N; i++)
+		{
+			m_RunningThreads.push_back(
+				std::async(
+					std::launch::async,
+					[this] { _ThreadWork(true);  }
+			));
+		}
+
+		std::unique_lock<std::mutex> lck(m_StartMut);
+		m_AllThreadsStarted.wait(lck, [&]
+			{
+				return m_StartedThreads == N;
+			});
+	}
+
+	void MutexThreadPool::CancelPendingTasks()
+	{
+		std::unique_lock<std::mutex> lck(m_M);
+		m_Queue.clear();
+	}
+
+	void MutexThreadPool::Finish()
+	{
+		{
+			std::unique_lock<std::mutex> lck(m_M);
+			// One empty task stops one thread
+			for (size_t i = 0; i < m_RunningThreads.size(); i++)
+			{
+				m_Queue.emplace_back();
+			}
+		}
+		m_Signal.notify_all();
+		m_RunningThreads.clear();
+	}
+
+	void MutexThreadPool::Abort()
+	{
+		CancelPendingTasks();
+		Finish();
+	}
+
+	void MutexThreadPool::_ThreadWork(bool StartingSync)
+	{
+		if (m_StartCallback)
+		{
+			m_StartCallback();
+		}
+
+		if (StartingSync)
+		{
+			{
+				std::unique_lock<std::mutex> lck(m_StartMut);
+				m_StartedThreads++;
+			}
+			m_AllThreadsStarted.notify_one();
+		}
+
+		while (true)
+		{
+			std::packaged_task<void()> f;
+			{
+				std::unique_lock<std::mutex> lck(m_M);
+				if (m_Queue.empty())
+				{
+					m_Signal.wait(lck, [&] { return !m_Queue.empty(); });
+				}
+
+				f = std::move(m_Queue.front());
+				m_Queue.pop_front();
+			}
+
+			if (!f.valid())
+			{
+				break;
+			}
+
+			f();
+		}
+
+		if (m_EndCallback)
+		{
+			m_EndCallback();
+		}
+	}
+}
\ No newline at end of file
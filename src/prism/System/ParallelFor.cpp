@@ -0,0 +1,82 @@
+#include "ParallelFor.h"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace Prism::System
+{
+	namespace
+	{
+		struct ChunkState
+		{
+			std::atomic<size_t> Next{ 0 };
+			std::atomic<size_t> Done{ 0 };
+			size_t Count{ 0 };
+			// Only called while Next < Count, the caller outlives every such call
+			const std::function<void(size_t)>* Chunk{ nullptr };
+			std::mutex ErrorMutex;
+			std::exception_ptr Error;
+		};
+
+		void ClaimChunks(ChunkState& state)
+		{
+			for (size_t i = state.Next.fetch_add(1); i < state.Count; i = state.Next.fetch_add(1))
+			{
+				try
+				{
+					(*state.Chunk)(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lck(state.ErrorMutex);
+					if (!state.Error)
+					{
+						state.Error = std::current_exception();
+					}
+				}
+				state.Done.fetch_add(1, std::memory_order_release);
+			}
+		}
+	}
+
+	void ParallelChunks(ThreadPool& pool, size_t chunks, const std::function<void(size_t)>& chunk)
+	{
+		// The caller takes a chunk itself, a single one never leaves this thread
+		const size_t helpers = chunks > 0 ? std::min(pool.GetWorkerCount(), chunks - 1) : 0;
+		if (helpers == 0)
+		{
+			for (size_t i = 0; i < chunks; i++)
+			{
+				chunk(i);
+			}
+			return;
+		}
+
+		// Shared with the helpers, the ones starting after the last chunk was claimed find nothing to do
+		auto state = MakeRef<ChunkState>();
+		state->Count = chunks;
+		state->Chunk = &chunk;
+
+		for (size_t i = 0; i < helpers; i++)
+		{
+			pool.Submit([state] { ClaimChunks(*state); });
+		}
+		ClaimChunks(*state);
+
+		// Every chunk left is running on another thread
+		while (state->Done.load(std::memory_order_acquire) < chunks)
+		{
+			if (!pool.RunPendingTask())
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		if (state->Error)
+		{
+			std::rethrow_exception(state->Error);
+		}
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "ThreadPool.h"
+
+namespace Prism::System
+{
+	// Data parallel loops on a pool. A range is cut into fixed chunks of
+	// grain indices that the pool workers and the calling thread claim one
+	// after another, so uneven chunks balance themselves. The caller always
+	// works through the chunks too and only waits on chunks that are already
+	// running, which makes nested calls from inside a worker safe: a worker
+	// that waits runs other pool tasks in the meantime. Exceptions thrown by
+	// a chunk are rethrown on the caller once every chunk finished
+
+	// Half open [X0, X1) x [Z0, Z1)
+	struct Tile
+	{
+		int X0{ 0 };
+		int Z0{ 0 };
+		int X1{ 0 };
+		int Z1{ 0 };
+	};
+
+	// A grain of 0 cuts a range into about this many chunks
+	constexpr size_t AutoChunks = 64;
+
+	// Calls chunk(i) for every i in [0, chunks), building block of the loops below
+	void ParallelChunks(ThreadPool& pool, size_t chunks, const std::function<void(size_t)>& chunk);
+
+	// Only depends on count, so chunking is the same on every machine
+	inline size_t AutoGrain(size_t count)
+	{
+		return std::max<size_t>((count + AutoChunks - 1) / AutoChunks, 1);
+	}
+
+	// body(first, last) is called for consecutive [first, last) sub ranges
+	template<typename F>
+	void ParallelFor(ThreadPool& pool, size_t begin, size_t end, size_t grain, F&& body)
+	{
+		if (end <= begin)
+		{
+			return;
+		}
+
+		const size_t count = end - begin;
+		grain = grain ? grain : AutoGrain(count);
+		ParallelChunks(pool, (count + grain - 1) / grain, [&](size_t i)
+			{
+				const size_t first = begin + i * grain;
+				body(first, std::min(first + grain, end));
+			});
+	}
+
+	template<typename F>
+	void ParallelFor(ThreadPool& pool, size_t begin, size_t end, F&& body)
+	{
+		ParallelFor(pool, begin, end, 0, std::forward<F>(body));
+	}
+
+	// body(tile) is called for tileX x tileZ tiles covering area, tiles on the
+	// far edges are clipped. A tile size of 0 picks square tiles
+	template<typename F>
+	void ParallelFor2D(ThreadPool& pool, const Tile& area, int tileX, int tileZ, F&& body)
+	{
+		const int width = area.X1 - area.X0;
+		const int depth = area.Z1 - area.Z0;
+		if (width <= 0 || depth <= 0)
+		{
+			return;
+		}
+
+		if (tileX <= 0 || tileZ <= 0)
+		{
+			const double cells = static_cast<double>(width) * depth / AutoChunks;
+			tileX = tileZ = std::max(static_cast<int>(std::ceil(std::sqrt(cells))), 1);
+		}
+
+		const int tilesX = (width + tileX - 1) / tileX;
+		const int tilesZ = (depth + tileZ - 1) / tileZ;
+		ParallelChunks(pool, static_cast<size_t>(tilesX) * tilesZ, [&](size_t i)
+			{
+				Tile tile;
+				tile.X0 = area.X0 + static_cast<int>(i % tilesX) * tileX;
+				tile.Z0 = area.Z0 + static_cast<int>(i / tilesX) * tileZ;
+				tile.X1 = std::min(tile.X0 + tileX, area.X1);
+				tile.Z1 = std::min(tile.Z0 + tileZ, area.Z1);
+				body(tile);
+			});
+	}
+
+	// map(first, last) reduces a chunk, the partial results are combined
+	// in chunk order on the caller. Chunks only depend on the range and the
+	// grain, so even non associative combines (float sums) give the same
+	// result for any worker count and schedule
+	template<typename T, typename Map, typename Combine>
+	T ParallelReduce(ThreadPool& pool, size_t begin, size_t end, size_t grain, T identity, Map&& map, Combine&& combine)
+	{
+		static_assert(!std::is_same_v<T, bool>, "vector<bool> can't be written from several threads");
+		if (end <= begin)
+		{
+			return identity;
+		}
+
+		const size_t count = end - begin;
+		grain = grain ? grain : AutoGrain(count);
+		std::vector<T> partial((count + grain - 1) / grain, identity);
+		ParallelChunks(pool, partial.size(), [&](size_t i)
+			{
+				const size_t first = begin + i * grain;
+				partial[i] = map(first, std::min(first + grain, end));
+			});
+
+		T result = std::move(identity);
+		for (auto& value : partial)
+		{
+			result = combine(std::move(result), std::move(value));
+		}
+		return result;
+	}
+}
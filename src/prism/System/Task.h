@@ -0,0 +1,278 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include "Debug.h"
+#include "MainThreadQueue.h"
+#include "ThreadPool.h"
+
+namespace Prism::System
+{
+	template<typename T>
+	class Task;
+
+	// Shared by every Task promise, the result lives in TaskPromise
+	class TaskPromiseBase
+	{
+	public:
+		struct FinalAwaiter
+		{
+			bool await_ready() noexcept { return false; }
+
+			// Hands the thread straight to the awaiting coroutine. The frame is
+			// never touched after Done is set, the owner may destroy it right away
+			template<typename Promise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+			{
+				auto& promise = handle.promise();
+				std::coroutine_handle<> continuation = promise.m_Continuation;
+				promise.m_Done.store(true, std::memory_order_release);
+				return continuation ? continuation : std::noop_coroutine();
+			}
+
+			void await_resume() noexcept {}
+		};
+
+		// Lazy, nothing runs until the task is started or awaited
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		FinalAwaiter final_suspend() noexcept { return {}; }
+		void unhandled_exception() { m_Error = std::current_exception(); }
+	protected:
+		template<typename T>
+		friend class Task;
+
+		std::coroutine_handle<> m_Continuation;
+		std::atomic<bool> m_Done{ false };
+		bool m_Started{ false };
+		std::exception_ptr m_Error;
+	};
+
+	template<typename T>
+	class TaskPromise : public TaskPromiseBase
+	{
+	public:
+		Task<T> get_return_object();
+
+		template<typename U>
+		void return_value(U&& value)
+		{
+			m_Value.emplace(std::forward<U>(value));
+		}
+
+		T TakeResult()
+		{
+			if (m_Error)
+			{
+				std::rethrow_exception(m_Error);
+			}
+			return std::move(*m_Value);
+		}
+	private:
+		std::optional<T> m_Value;
+	};
+
+	template<>
+	class TaskPromise<void> : public TaskPromiseBase
+	{
+	public:
+		Task<void> get_return_object();
+
+		void return_void() {}
+
+		void TakeResult()
+		{
+			if (m_Error)
+			{
+				std::rethrow_exception(m_Error);
+			}
+		}
+	};
+
+	// Coroutine returning T. A task either gets awaited by another coroutine,
+	// which resumes on whatever thread the task finishes on, or is started as
+	// a root task that its owner polls with IsDone. Running tasks hop threads
+	// with the ResumeOn awaitables below, so no thread ever blocks on one.
+	// A started task must not be destroyed before it's done
+	template<typename T = void>
+	class Task
+	{
+	public:
+		using promise_type = TaskPromise<T>;
+		using Handle = std::coroutine_handle<promise_type>;
+
+		Task() = default;
+		explicit Task(Handle handle)
+			:
+			m_Handle(handle)
+		{}
+
+		Task(Task&& other) noexcept
+			:
+			m_Handle(std::exchange(other.m_Handle, nullptr))
+		{}
+
+		Task& operator=(Task&& other) noexcept
+		{
+			if (this != &other)
+			{
+				_Destroy();
+				m_Handle = std::exchange(other.m_Handle, nullptr);
+			}
+			return *this;
+		}
+
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		~Task()
+		{
+			_Destroy();
+		}
+
+		bool IsValid() const { return static_cast<bool>(m_Handle); }
+
+		bool IsDone() const
+		{
+			return m_Handle && m_Handle.promise().m_Done.load(std::memory_order_acquire);
+		}
+
+		// Runs on the calling thread until the first suspension
+		void Start()
+		{
+			PR_ASSERT(m_Handle && !m_Handle.promise().m_Started, "(Task) Starting an empty or started task");
+			m_Handle.promise().m_Started = true;
+			m_Handle.resume();
+		}
+
+		// Result of a finished task, rethrows what the coroutine threw
+		T Get()
+		{
+			PR_ASSERT(IsDone(), "(Task) Result of a task that isn't done");
+			return m_Handle.promise().TakeResult();
+		}
+
+		auto operator co_await() && noexcept
+		{
+			struct Awaiter
+			{
+				Handle Awaited;
+
+				bool await_ready() const noexcept { return false; }
+
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+				{
+					Awaited.promise().m_Continuation = awaiting;
+					Awaited.promise().m_Started = true;
+					return Awaited;
+				}
+
+				T await_resume()
+				{
+					return Awaited.promise().TakeResult();
+				}
+			};
+
+			PR_ASSERT(m_Handle && !m_Handle.promise().m_Started, "(Task) Awaiting an empty or started task");
+			return Awaiter{ m_Handle };
+		}
+	private:
+		void _Destroy()
+		{
+			if (m_Handle)
+			{
+				PR_ASSERT(!m_Handle.promise().m_Started || IsDone(), "(Task) Destroyed while running");
+				m_Handle.destroy();
+				m_Handle = nullptr;
+			}
+		}
+
+		Handle m_Handle;
+	};
+
+	template<typename T>
+	Task<T> TaskPromise<T>::get_return_object()
+	{
+		return Task<T>(Task<T>::Handle::from_promise(*this));
+	}
+
+	inline Task<void> TaskPromise<void>::get_return_object()
+	{
+		return Task<void>(Task<void>::Handle::from_promise(*this));
+	}
+
+	// co_await ResumeOn(pool) continues the coroutine on a worker of pool.
+	// A pool that drops its pending tasks (Abort, CancelPendingTasks)
+	// leaves the coroutines waiting on it suspended for good
+	class ScheduleOnPool
+	{
+	public:
+		ScheduleOnPool(ThreadPool& pool, std::optional<int> priority)
+			:
+			m_Pool(pool),
+			m_Priority(priority)
+		{}
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			// The coroutine can finish on a worker before Submit returns, nothing touches the awaiter after it
+			if (m_Priority)
+			{
+				m_Pool.Submit([handle] { handle.resume(); }, *m_Priority);
+			}
+			else
+			{
+				m_Pool.Submit([handle] { handle.resume(); });
+			}
+		}
+
+		void await_resume() const noexcept {}
+	private:
+		ThreadPool& m_Pool;
+		std::optional<int> m_Priority;
+	};
+
+	// co_await ResumeOn(queue) continues the coroutine the next time the queue
+	// is drained. Awaiting it from a drained task moves on to the next drain,
+	// which makes it a way to wait for the next frame
+	class ScheduleOnQueue
+	{
+	public:
+		explicit ScheduleOnQueue(MainThreadQueue& queue)
+			:
+			m_Queue(queue)
+		{}
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			m_Queue.Post([handle] { handle.resume(); });
+		}
+
+		void await_resume() const noexcept {}
+	private:
+		MainThreadQueue& m_Queue;
+	};
+
+	// Without a priority a worker resuming onto its own pool keeps the coroutine on its deque
+	inline ScheduleOnPool ResumeOn(ThreadPool& pool)
+	{
+		return ScheduleOnPool(pool, std::nullopt);
+	}
+
+	inline ScheduleOnPool ResumeOn(ThreadPool& pool, int priority)
+	{
+		return ScheduleOnPool(pool, priority);
+	}
+
+	inline ScheduleOnQueue ResumeOn(MainThreadQueue& queue)
+	{
+		return ScheduleOnQueue(queue);
+	}
+}
@@ -0,0 +1,78 @@
+#include "TaskGraph.h"
+
+namespace Prism::System
+{
+	TaskGraph::TaskGraph(Ref<ThreadPool> pool, Ref<MainThreadQueue> main)
+		:
+		m_Pool(std::move(pool)),
+		m_Main(std::move(main))
+	{}
+
+	TaskGraph::Node TaskGraph::Add(Affinity affinity, int priority)
+	{
+		PR_ASSERT(affinity != Affinity::MAIN || m_Main, "(TaskGraph) Main node without a main queue");
+
+		NodeData& node = m_Nodes.emplace_back();
+		node.NodeAffinity = affinity;
+		node.Priority = priority;
+		m_Unfinished.fetch_add(1);
+		return m_Nodes.size() - 1;
+	}
+
+	void TaskGraph::Precede(Node before, Node after)
+	{
+		PR_ASSERT(before != after, "(TaskGraph) Node preceding itself");
+
+		m_Nodes[before].Successors.push_back(after);
+		NodeData& node = m_Nodes[after];
+		// Nobody waits yet, the latch can still be reset
+		node.Ready.Reset(++node.Dependencies);
+	}
+
+	TaskGraph::Node TaskGraph::Then(Node before, Affinity affinity, int priority)
+	{
+		const Node node = Add(affinity, priority);
+		Precede(before, node);
+		return node;
+	}
+
+	Task<void> TaskGraph::Enter(Node node)
+	{
+		NodeData& data = m_Nodes[node];
+		// The last dependency resumes the waiter inline, wherever it ran
+		const bool waited = !data.Ready.IsReady();
+		if (waited)
+		{
+			co_await data.Ready;
+		}
+
+		switch (data.NodeAffinity)
+		{
+		case Affinity::MAIN:
+			co_await ResumeOn(*m_Main);
+			break;
+		case Affinity::WORKER:
+			if (waited || !m_Pool->IsWorkerThread())
+			{
+				co_await ResumeOn(*m_Pool, data.Priority);
+			}
+			break;
+		case Affinity::ANY:
+			break;
+		}
+	}
+
+	void TaskGraph::Leave(Node node)
+	{
+		for (Node successor : m_Nodes[node].Successors)
+		{
+			m_Nodes[successor].Ready.CountDown();
+		}
+		m_Unfinished.fetch_sub(1);
+	}
+
+	bool TaskGraph::IsDone() const
+	{
+		return m_Unfinished.load() == 0;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include "AsyncLatch.h"
+#include "MainThreadQueue.h"
+#include "Task.h"
+#include "ThreadPool.h"
+#include "prism/Core/Pointers.h"
+
+namespace Prism::System
+{
+	// Dependencies between the stages of coroutines. Every stage is a node,
+	// a coroutine starts one with co_await Enter(node), which waits for the
+	// nodes preceding it through a fan-in latch and continues where the node
+	// runs, and calls Leave(node) once done to release the nodes after it.
+	// Nodes are added and linked before the first one is entered. A stage
+	// has to Leave even when it was cancelled or threw, its dependents wait
+	// forever otherwise. The graph must outlive the coroutines using it
+	class TaskGraph
+	{
+	public:
+		using Node = size_t;
+
+		enum class Affinity
+		{
+			// On a worker of the pool
+			WORKER = 0,
+			// On the main thread the next time its queue is drained
+			MAIN,
+			// Inline on the thread leaving the last dependency, for cheap joins
+			ANY
+		};
+
+		// Main nodes need a main queue
+		TaskGraph(Ref<ThreadPool> pool, Ref<MainThreadQueue> main = nullptr);
+
+		Node Add(Affinity affinity = Affinity::WORKER, int priority = ThreadPool::DefaultPriority);
+		// after is entered once before was left
+		void Precede(Node before, Node after);
+		// Adds a node entered after before
+		Node Then(Node before, Affinity affinity = Affinity::WORKER, int priority = ThreadPool::DefaultPriority);
+
+		// Worker nodes whose dependencies were left already stay on the calling worker
+		Task<void> Enter(Node node);
+		void Leave(Node node);
+
+		// Every node was left
+		bool IsDone() const;
+		size_t GetNodeCount() const { return m_Nodes.size(); }
+	private:
+		struct NodeData
+		{
+			Affinity NodeAffinity{ Affinity::WORKER };
+			int Priority{ ThreadPool::DefaultPriority };
+			std::vector<Node> Successors;
+			int Dependencies{ 0 };
+			AsyncLatch Ready;
+		};
+
+		Ref<ThreadPool> m_Pool;
+		Ref<MainThreadQueue> m_Main;
+		// Deque keeps the latches in place while nodes are added
+		std::deque<NodeData> m_Nodes;
+		std::atomic<size_t> m_Unfinished{ 0 };
+	};
+}
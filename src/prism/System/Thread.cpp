@@ -0,0 +1,65 @@
+#include "Thread.h"
+
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Prism::System
+{
+	int HardwareThreads()
+	{
+		const unsigned int count = std::thread::hardware_concurrency();
+		return count ? static_cast<int>(count) : 1;
+	}
+
+#ifdef _WIN32
+	void SetCurrentThreadName(const std::string& name)
+	{
+		const std::wstring wide(name.begin(), name.end());
+		SetThreadDescription(GetCurrentThread(), wide.c_str());
+	}
+
+	bool PinCurrentThread(int core)
+	{
+		if (core < 0 || core >= 64)
+		{
+			return false;
+		}
+		return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core) != 0;
+	}
+#else
+	void SetCurrentThreadName(const std::string& name)
+	{
+#ifdef __APPLE__
+		pthread_setname_np(name.substr(0, 63).c_str());
+#else
+		pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+#endif
+	}
+
+	bool PinCurrentThread(int core)
+	{
+#ifdef __linux__
+		if (core < 0 || core >= CPU_SETSIZE)
+		{
+			return false;
+		}
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(core, &set);
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+		// No hard affinity on macOS
+		return false;
+#endif
+	}
+#endif
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+namespace Prism::System
+{
+	// Logical cores, at least 1
+	int HardwareThreads();
+	// Shows up in debuggers and profilers, linux cuts it to 15 characters
+	void SetCurrentThreadName(const std::string& name);
+	// Restricts the calling thread to one logical core, returns false when the os refused
+	bool PinCurrentThread(int core);
+}
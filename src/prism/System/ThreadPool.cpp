@@ -1,7 +1,106 @@
 #include "ThreadPool.h"
 
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+#include "Thread.h"
+
 namespace Prism::System
 {
+	namespace
+	{
+		// Rounds of looking for work before a worker parks
+		constexpr int SpinCount = 64;
+
+		// Free tasks move between a thread and the depot this many at a time
+		constexpr size_t TaskBatch = 64;
+
+		std::atomic<uint64_t> s_TasksAllocated{ 0 };
+
+		// Only called by the counter's single writer
+		template<typename T>
+		void AddRelaxed(std::atomic<T>& counter, T value)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		// Worker running on this thread, lets QueueTask push to the local deque
+		thread_local const void* t_Pool = nullptr;
+		thread_local size_t t_Worker = 0;
+
+		// Reading the clock costs as much as queueing an empty task,
+		// only every WaitSampleRate-th task a thread queues is timed
+		constexpr uint32_t WaitSampleRate = 8;
+		thread_local uint32_t t_Queued = 0;
+
+		// Run time of the tasks RunPendingTask ran inside the task running on this
+		// thread. They count on their own, the outer task's busy time leaves them out
+		thread_local long long t_NestedNanoseconds = 0;
+		thread_local int t_RunDepth = 0;
+
+		uint32_t NextRandom(uint32_t& state)
+		{
+			// xorshift32, only used to spread thieves over victims
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		template<typename Task>
+		bool RunsLater(const Task* a, const Task* b)
+		{
+			return a->Priority != b->Priority ? a->Priority > b->Priority : a->Sequence > b->Sequence;
+		}
+	}
+
+	// Tasks are released on the thread that ran them, so a thread that only
+	// submits would never see one again. Past two batches a thread hands a
+	// batch to the depot, threads running out take one from there
+	struct ThreadPool::TaskCache
+	{
+		struct Depot
+		{
+			std::mutex Mutex;
+			// Each one links TaskBatch tasks through Next
+			std::vector<Task*> Chains;
+			// Lets allocations skip the lock while it's empty
+			std::atomic<size_t> Count{ 0 };
+
+			~Depot()
+			{
+				for (Task* chain : Chains)
+				{
+					TaskCache::DeleteChain(chain);
+				}
+			}
+		};
+
+		static Depot& GetDepot()
+		{
+			static Depot depot;
+			return depot;
+		}
+
+		static void DeleteChain(Task* task)
+		{
+			while (task)
+			{
+				delete std::exchange(task, task->Next);
+			}
+		}
+
+		Task* Head{ nullptr };
+		size_t Count{ 0 };
+
+		// Exiting threads don't give their tasks back, the depot may be gone already
+		~TaskCache()
+		{
+			DeleteChain(Head);
+		}
+	};
+
 	ThreadPool::ThreadPool()
 	{
 	}
@@ -20,32 +119,24 @@ namespace Prism::System
 	ThreadPool::~ThreadPool()
 	{
 		Finish();
+
+		// Only left over when the pool was never started
+		for (Task* task : m_Injected)
+		{
+			_ReleaseTask(task);
+		}
 	}
 
 	void ThreadPool::Start(size_t N)
 	{
-		for (int i = 0; i < N; i++)
-		{
-			m_RunningThreads.push_back(
-				std::async(
-					std::launch::async,
-					[this] { _ThreadWork();  }
-			));
-		}
+		_Launch(N, false);
 	}
 
 	void ThreadPool::StartSync(size_t N)
 	{
-		for (int i = 0; i < N; i++)
-		{
-			m_RunningThreads.push_back(
-				std::async(
-					std::launch::async,
-					[this] { _ThreadWork(true);  }
-			));
-		}
+		_Launch(N, true);
 
-		std::unique_lock<std::mutex> lck(m_M);
+		std::unique_lock<std::mutex> lck(m_StartMut);
 		m_AllThreadsStarted.wait(lck, [&]
 			{
 				return m_StartedThreads == N;
@@ -54,21 +145,45 @@ namespace Prism::System
 
 	void ThreadPool::CancelPendingTasks()
 	{
-		std::unique_lock<std::mutex> lck(m_M);
-		m_Queue.clear();
+		// Tasks in the deques are dropped when a worker takes them
+		m_Generation.fetch_add(1, std::memory_order_acq_rel);
+
+		std::vector<Task*> dropped;
+		{
+			std::lock_guard<std::mutex> lck(m_InjectMutex);
+			dropped.swap(m_Injected);
+			m_InjectedCount.store(0, std::memory_order_relaxed);
+		}
+
+		m_Pending.fetch_sub(dropped.size());
+		m_Dropped.fetch_add(dropped.size(), std::memory_order_relaxed);
+		for (Task* task : dropped)
+		{
+			_ReleaseTask(task);
+		}
 	}
 
 	void ThreadPool::Finish()
 	{
+		if (m_Workers.empty())
 		{
-			std::unique_lock<std::mutex> lck(m_M);
-			for (auto&& unsused : m_RunningThreads)
-			{
-				m_Queue.emplace_back();
-			}
+			return;
+		}
+
+		m_Stopping.store(true);
+		{
+			std::lock_guard<std::mutex> lck(m_ParkMutex);
+		}
+		m_Parked.notify_all();
+
+		for (auto& worker : m_Workers)
+		{
+			worker->Thread.join();
 		}
-		m_Signal.notify_all();
-		m_RunningThreads.clear();
+
+		m_Workers.clear();
+		m_StartedThreads = 0;
+		m_Stopping.store(false);
 	}
 
 	void ThreadPool::Abort()
@@ -77,8 +192,286 @@ namespace Prism::System
 		Finish();
 	}
 
-	void ThreadPool::_ThreadWork(bool StartingSync)
+	void ThreadPool::SetName(const std::string& name)
+	{
+		m_Name = name;
+	}
+
+	void ThreadPool::SetAffinity(bool pin, int firstCore)
+	{
+		m_Pin = pin;
+		m_FirstCore = firstCore;
+	}
+
+	uint64_t ThreadPool::Histogram::Total() const
+	{
+		uint64_t total = 0;
+		for (uint64_t count : Counts)
+		{
+			total += count;
+		}
+		return total;
+	}
+
+	long long ThreadPool::Histogram::Percentile(double fraction) const
+	{
+		const uint64_t total = Total();
+		if (total == 0)
+		{
+			return 0;
+		}
+
+		const double target = std::clamp(fraction, 0.0, 1.0) * total;
+		uint64_t seen = 0;
+		for (size_t i = 0; i < Buckets; i++)
+		{
+			seen += Counts[i];
+			if (seen >= target && seen > 0)
+			{
+				return UpperBound(i);
+			}
+		}
+		return UpperBound(Buckets - 1);
+	}
+
+	void ThreadPool::Histogram::Merge(const Histogram& other)
+	{
+		for (size_t i = 0; i < Buckets; i++)
+		{
+			Counts[i] += other.Counts[i];
+		}
+	}
+
+	ThreadPool::Stats ThreadPool::GetStats() const
+	{
+		Stats stats;
+		stats.Workers = m_Workers.size();
+		stats.Pending = m_Pending.load(std::memory_order_relaxed);
+		stats.PendingHighWater = m_PendingHighWater.load(std::memory_order_relaxed);
+		stats.TasksQueued = m_ExternalQueued.load(std::memory_order_relaxed);
+		stats.TasksCancelled = m_Dropped.load(std::memory_order_relaxed);
+		const auto now = Time::Clock::now();
+		if (!m_Workers.empty())
+		{
+			stats.UptimeNanoseconds = Time::DurationCast<Time::Nanoseconds>(now - m_StartTime);
+		}
+
+		for (auto& worker : m_Workers)
+		{
+			WorkerStats perWorker;
+			perWorker.TasksQueued = worker->TasksQueued.load(std::memory_order_relaxed);
+			perWorker.TasksRun = worker->TasksRun.load(std::memory_order_relaxed);
+			perWorker.TasksCancelled = worker->TasksCancelled.load(std::memory_order_relaxed);
+			perWorker.BusyNanoseconds = worker->BusyNanoseconds.load(std::memory_order_relaxed);
+			perWorker.ParkedNanoseconds = worker->ParkedNanoseconds.load(std::memory_order_relaxed);
+			// A park still going on counts up to now
+			if (const long long since = worker->ParkedSince.load(std::memory_order_relaxed))
+			{
+				perWorker.ParkedNanoseconds += std::max(Time::DurationCast<Time::Nanoseconds>(now.time_since_epoch()) - since, 0ll);
+			}
+			perWorker.IdleNanoseconds = std::max(stats.UptimeNanoseconds - perWorker.BusyNanoseconds, 0ll);
+			for (size_t i = 0; i < Histogram::Buckets; i++)
+			{
+				perWorker.WaitTime.Counts[i] = worker->WaitBuckets[i].load(std::memory_order_relaxed);
+				perWorker.RunTime.Counts[i] = worker->RunBuckets[i].load(std::memory_order_relaxed);
+			}
+
+			stats.TasksQueued += perWorker.TasksQueued;
+			stats.TasksRun += perWorker.TasksRun;
+			stats.TasksCancelled += perWorker.TasksCancelled;
+			stats.BusyNanoseconds += perWorker.BusyNanoseconds;
+			stats.ParkedNanoseconds += perWorker.ParkedNanoseconds;
+			stats.IdleNanoseconds += perWorker.IdleNanoseconds;
+			stats.WaitTime.Merge(perWorker.WaitTime);
+			stats.RunTime.Merge(perWorker.RunTime);
+			stats.PerWorker.push_back(perWorker);
+		}
+
+		const double available = static_cast<double>(stats.UptimeNanoseconds) * stats.Workers;
+		stats.Utilisation = available > 0 ? static_cast<float>(stats.BusyNanoseconds / available) : 0.f;
+		return stats;
+	}
+
+	uint64_t ThreadPool::TasksAllocated()
+	{
+		return s_TasksAllocated.load(std::memory_order_relaxed);
+	}
+
+	ThreadPool::TaskCache& ThreadPool::_LocalCache()
+	{
+		thread_local TaskCache cache;
+		return cache;
+	}
+
+	ThreadPool::Task* ThreadPool::_AllocateTask()
+	{
+		TaskCache& cache = _LocalCache();
+		if (!cache.Head)
+		{
+			auto& depot = TaskCache::GetDepot();
+			if (depot.Count.load(std::memory_order_relaxed) > 0)
+			{
+				std::lock_guard<std::mutex> lck(depot.Mutex);
+				if (!depot.Chains.empty())
+				{
+					cache.Head = depot.Chains.back();
+					cache.Count = TaskBatch;
+					depot.Chains.pop_back();
+					depot.Count.store(depot.Chains.size(), std::memory_order_relaxed);
+				}
+			}
+		}
+
+		if (Task* task = cache.Head)
+		{
+			cache.Head = std::exchange(task->Next, nullptr);
+			cache.Count--;
+			return task;
+		}
+
+		s_TasksAllocated.fetch_add(1, std::memory_order_relaxed);
+		return new Task;
+	}
+
+	void ThreadPool::_ReleaseTask(Task* task)
+	{
+		task->Destroy(*task);
+		task->Invoke = nullptr;
+		task->Destroy = nullptr;
+		task->Token = {};
+
+		TaskCache& cache = _LocalCache();
+		task->Next = cache.Head;
+		cache.Head = task;
+		cache.Count++;
+		if (cache.Count < 2 * TaskBatch)
+		{
+			return;
+		}
+
+		Task* last = cache.Head;
+		for (size_t i = 1; i < TaskBatch; i++)
+		{
+			last = last->Next;
+		}
+		Task* chain = std::exchange(cache.Head, last->Next);
+		last->Next = nullptr;
+		cache.Count -= TaskBatch;
+
+		auto& depot = TaskCache::GetDepot();
+		std::lock_guard<std::mutex> lck(depot.Mutex);
+		depot.Chains.push_back(chain);
+		depot.Count.store(depot.Chains.size(), std::memory_order_relaxed);
+	}
+
+	void ThreadPool::_Launch(size_t N, bool StartingSync)
+	{
+		PR_ASSERT(m_Workers.empty(), "ThreadPool is already running");
+		m_StartTime = Time::Clock::now();
+		m_PendingHighWater.store(m_Pending.load(), std::memory_order_relaxed);
+
+		// Every deque exists before the first thief looks at them
+		for (size_t i = 0; i < N; i++)
+		{
+			auto worker = MakePtr<Worker>();
+			worker->Seed = static_cast<uint32_t>(i + 1) * 2654435761u;
+			m_Workers.push_back(std::move(worker));
+		}
+
+		for (size_t i = 0; i < N; i++)
+		{
+			m_Workers[i]->Thread = std::thread([this, i, StartingSync] { _ThreadWork(i, StartingSync); });
+		}
+	}
+
+	bool ThreadPool::IsWorkerThread() const
+	{
+		return t_Pool == this;
+	}
+
+	bool ThreadPool::RunPendingTask()
+	{
+		if (!IsWorkerThread())
+		{
+			return false;
+		}
+
+		Worker& self = *m_Workers[t_Worker];
+		Task* task = _FindTask(self);
+		if (!task)
+		{
+			return false;
+		}
+		_Run(self, task);
+		return true;
+	}
+
+	void ThreadPool::_Submit(Task* task, bool prioritised)
+	{
+		task->Generation = m_Generation.load(std::memory_order_acquire);
+		task->Queued = (t_Queued++ % WaitSampleRate) == 0 ? Time::Clock::now() : Time::TimePoint{};
+
+		if (t_Pool == this)
+		{
+			AddRelaxed<uint64_t>(m_Workers[t_Worker]->TasksQueued, 1);
+		}
+		else
+		{
+			m_ExternalQueued.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// Counted before it's visible so a worker taking it never underflows
+		const size_t depth = m_Pending.fetch_add(1) + 1;
+		size_t highWater = m_PendingHighWater.load(std::memory_order_relaxed);
+		while (depth > highWater && !m_PendingHighWater.compare_exchange_weak(highWater, depth, std::memory_order_relaxed))
+		{
+		}
+
+		if (t_Pool == this && !prioritised)
+		{
+			m_Workers[t_Worker]->Deque.Push(task);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lck(m_InjectMutex);
+			task->Sequence = m_NextSequence++;
+			m_Injected.push_back(task);
+			std::push_heap(m_Injected.begin(), m_Injected.end(), RunsLater<Task>);
+			m_InjectedCount.fetch_add(1, std::memory_order_release);
+		}
+
+		_Wake();
+	}
+
+	void ThreadPool::_Wake()
+	{
+		// Pairs with the increment of m_Sleeping before a worker checks m_Pending,
+		// one of the two sides always sees the other
+		if (m_Sleeping.load() > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lck(m_ParkMutex);
+			}
+			m_Parked.notify_one();
+		}
+	}
+
+	void ThreadPool::_ThreadWork(size_t index, bool StartingSync)
 	{
+		t_Pool = this;
+		t_Worker = index;
+		Worker& self = *m_Workers[index];
+
+		SetCurrentThreadName(m_Name + "/" + std::to_string(index));
+		if (m_Pin)
+		{
+			const int core = static_cast<int>((m_FirstCore + index) % HardwareThreads());
+			if (!PinCurrentThread(core))
+			{
+				PR_CORE_WARN("(ThreadPool) Couldn't pin {0}/{1} to core {2}", m_Name, index, core);
+			}
+		}
+
 		if (m_StartCallback)
 		{
 			m_StartCallback();
@@ -95,29 +488,124 @@ namespace Prism::System
 
 		while (true)
 		{
-			std::packaged_task<void()> f;
+			Task* task = _FindTask(self);
+			for (int spin = 0; !task && spin < SpinCount; spin++)
 			{
-				std::unique_lock<std::mutex> lck(m_M);
-				if (m_Queue.empty())
-				{
-					m_Signal.wait(lck, [&] { return !m_Queue.empty(); });
-				}
+				std::this_thread::yield();
+				task = _FindTask(self);
+			}
 
-				f = std::move(m_Queue.front());
-				m_Queue.pop_front();
+			if (task)
+			{
+				_Run(self, task);
+				continue;
 			}
 
-			if (!f.valid())
+			const long long parked = Time::DurationCast<Time::Nanoseconds>(Time::Clock::now().time_since_epoch());
+			self.ParkedSince.store(parked, std::memory_order_relaxed);
+			m_Sleeping.fetch_add(1);
 			{
-				break;
+				std::unique_lock<std::mutex> lck(m_ParkMutex);
+				m_Parked.wait(lck, [&] { return m_Pending.load() > 0 || m_Stopping.load(); });
 			}
+			m_Sleeping.fetch_sub(1);
+			self.ParkedSince.store(0, std::memory_order_relaxed);
+			AddRelaxed(self.ParkedNanoseconds, Time::DurationCast<Time::Nanoseconds>(Time::Clock::now().time_since_epoch()) - parked);
 
-			f();
+			// Finishing still runs everything that was queued
+			if (m_Stopping.load() && m_Pending.load() == 0)
+			{
+				break;
+			}
 		}
 
 		if (m_EndCallback)
 		{
 			m_EndCallback();
 		}
+
+		t_Pool = nullptr;
+	}
+
+	ThreadPool::Task* ThreadPool::_FindTask(Worker& self)
+	{
+		Task* task = nullptr;
+		if (self.Deque.Pop(task))
+		{
+			return task;
+		}
+
+		if ((task = _TakeInjected()))
+		{
+			return task;
+		}
+
+		const size_t count = m_Workers.size();
+		const size_t first = NextRandom(self.Seed) % count;
+		for (size_t i = 0; i < count; i++)
+		{
+			Worker& victim = *m_Workers[(first + i) % count];
+			if (&victim != &self && victim.Deque.Steal(task))
+			{
+				return task;
+			}
+		}
+		return nullptr;
+	}
+
+	ThreadPool::Task* ThreadPool::_TakeInjected()
+	{
+		if (m_InjectedCount.load(std::memory_order_acquire) == 0)
+		{
+			return nullptr;
+		}
+
+		std::lock_guard<std::mutex> lck(m_InjectMutex);
+		if (m_Injected.empty())
+		{
+			return nullptr;
+		}
+
+		std::pop_heap(m_Injected.begin(), m_Injected.end(), RunsLater<Task>);
+		Task* task = m_Injected.back();
+		m_Injected.pop_back();
+		m_InjectedCount.fetch_sub(1, std::memory_order_relaxed);
+		return task;
+	}
+
+	void ThreadPool::_Run(Worker& self, Task* task)
+	{
+		m_Pending.fetch_sub(1);
+
+		// Releasing a task that never ran breaks its promise, same as a cleared queue
+		if (task->Generation == m_Generation.load(std::memory_order_acquire) && !task->Token.IsCancelled())
+		{
+			const long long outerNested = t_NestedNanoseconds;
+			t_NestedNanoseconds = 0;
+			t_RunDepth++;
+
+			const auto start = Time::Clock::now();
+			task->Invoke(*task);
+			const auto end = Time::Clock::now();
+			const long long total = Time::DurationCast<Time::Nanoseconds>(end - start);
+			const long long busy = total - t_NestedNanoseconds;
+
+			t_RunDepth--;
+			t_NestedNanoseconds = t_RunDepth > 0 ? outerNested + total : 0;
+
+			AddRelaxed(self.BusyNanoseconds, busy);
+			AddRelaxed<uint64_t>(self.TasksRun, 1);
+			AddRelaxed<uint64_t>(self.RunBuckets[Histogram::BucketFor(busy)], 1);
+			if (task->Queued != Time::TimePoint{})
+			{
+				const long long wait = Time::DurationCast<Time::Nanoseconds>(start - task->Queued);
+				AddRelaxed<uint64_t>(self.WaitBuckets[Histogram::BucketFor(wait)], 1);
+			}
+		}
+		else
+		{
+			AddRelaxed<uint64_t>(self.TasksCancelled, 1);
+		}
+		_ReleaseTask(task);
 	}
-}
\ No newline at end of file
+}
@@ -1,53 +1,322 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <type_traits>
 #include <functional>
-#include <queue>
 #include <future>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CancellationToken.h"
+#include "Time.h"
 #include "Types.h"
+#include "WorkStealingDeque.h"
+#include "prism/Core/Pointers.h"
 
 namespace Prism::System
 {
+	// Work stealing pool. Every worker owns a Chase-Lev deque, tasks queued
+	// from a worker go to its own deque and are popped newest first, tasks
+	// queued from other threads go through a shared injection queue. Idle
+	// workers take from the injection queue, steal the oldest task of a random
+	// victim, spin for a while and finally park until work is queued.
+	// Injected tasks are taken lowest priority first, FIFO within a priority.
+	// Tasks given a token are dropped when it's cancelled before they start,
+	// callables taking a const CancellationToken& get it passed to check while running.
+	// Submit is fire and forget: callables up to InlineTaskSize bytes are stored
+	// in the task itself and tasks are recycled through per thread free lists,
+	// so it doesn't allocate once the lists are warm. A callable submitted this
+	// way must not throw. QueueTask adds a future, at the cost of its shared state
 	class ThreadPool
 	{
-
 	public:
+		static constexpr int DefaultPriority = 0;
+		static constexpr size_t InlineTaskSize = 64;
+
 		ThreadPool();
 		ThreadPool(VoidCallback StartCallback);
 		ThreadPool(VoidCallback StartCallback, VoidCallback EndCallback);
 		~ThreadPool();
 
 		template<typename F>
-		std::future<void> QueueTask(F f)
+		void Submit(F f)
 		{
-			std::packaged_task<void()> task(std::forward<F>(f));
+			_Queue(std::move(f), DefaultPriority, {}, false);
+		}
 
-			auto r = task.get_future();
+		// Always goes through the injection queue so the priority is respected
+		template<typename F>
+		void Submit(F f, int priority)
+		{
+			_Queue(std::move(f), priority, {}, true);
+		}
 
-			{
-				std::unique_lock<std::mutex> lck(m_M);
-				m_Queue.emplace_back(std::move(task));
-			}
+		template<typename F>
+		void Submit(F f, CancellationToken token)
+		{
+			_Queue(std::move(f), DefaultPriority, std::move(token), false);
+		}
 
-			m_Signal.notify_one();
+		template<typename F>
+		void Submit(F f, int priority, CancellationToken token)
+		{
+			_Queue(std::move(f), priority, std::move(token), true);
+		}
 
-			return r;
+		template<typename F>
+		std::future<void> QueueTask(F f)
+		{
+			return _QueueWithFuture(std::move(f), DefaultPriority, {}, false);
 		}
 
+		template<typename F>
+		std::future<void> QueueTask(F f, int priority)
+		{
+			return _QueueWithFuture(std::move(f), priority, {}, true);
+		}
+
+		template<typename F>
+		std::future<void> QueueTask(F f, CancellationToken token)
+		{
+			return _QueueWithFuture(std::move(f), DefaultPriority, std::move(token), false);
+		}
+
+		template<typename F>
+		std::future<void> QueueTask(F f, int priority, CancellationToken token)
+		{
+			return _QueueWithFuture(std::move(f), priority, std::move(token), true);
+		}
+
+		// True on the workers of this pool
+		bool IsWorkerThread() const;
+		// Runs one queued task on the calling worker so a worker waiting on
+		// other tasks can help instead of blocking. False from any other
+		// thread or when nothing was found
+		bool RunPendingTask();
+
+		// Drops every task that hasn't started, their futures get broken_promise
 		void CancelPendingTasks();
 		void Abort();
+		// Runs the queued tasks and joins the workers
 		void Finish();
 		void Start(size_t N = 1);
 		void StartSync(size_t N = 1);
+
+		// Both apply to the workers of the next Start. Threads are named
+		// "name/index", pinned pools put worker i on core (firstCore + i) % cores
+		void SetName(const std::string& name);
+		void SetAffinity(bool pin, int firstCore = 0);
+
+		// Durations on a log2 scale, bucket i counts [2^(i-1), 2^i) nanoseconds
+		// and the last one everything longer
+		struct Histogram
+		{
+			static constexpr size_t Buckets = 32;
+			uint64_t Counts[Buckets]{};
+
+			static size_t BucketFor(long long nanoseconds)
+			{
+				const auto width = std::bit_width(static_cast<uint64_t>(std::max(nanoseconds, 0ll)));
+				return std::min<size_t>(width, Buckets - 1);
+			}
+
+			static long long UpperBound(size_t bucket) { return 1ll << bucket; }
+
+			uint64_t Total() const;
+			// Upper bound of the bucket the fraction of samples falls below, 0 without samples
+			long long Percentile(double fraction) const;
+			void Merge(const Histogram& other);
+		};
+
+		struct WorkerStats
+		{
+			// Queued from this worker, to its deque or with a priority
+			uint64_t TasksQueued{ 0 };
+			uint64_t TasksRun{ 0 };
+			// Taken after their token or the pool cancelled them
+			uint64_t TasksCancelled{ 0 };
+			long long BusyNanoseconds{ 0 };
+			// Asleep waiting for work, idle time not parked was spent looking for tasks
+			long long ParkedNanoseconds{ 0 };
+			long long IdleNanoseconds{ 0 };
+			// From queueing to starting, sampled on one task in eight, and running.
+			// Busy and run time leave out tasks run inside a task through RunPendingTask
+			Histogram WaitTime;
+			Histogram RunTime;
+		};
+
+		struct Stats
+		{
+			size_t Workers{ 0 };
+			size_t Pending{ 0 };
+			// Most tasks pending at once since Start
+			size_t PendingHighWater{ 0 };
+			uint64_t TasksQueued{ 0 };
+			uint64_t TasksRun{ 0 };
+			// Dropped when taken plus the ones CancelPendingTasks dropped
+			uint64_t TasksCancelled{ 0 };
+			long long BusyNanoseconds{ 0 };
+			long long ParkedNanoseconds{ 0 };
+			long long IdleNanoseconds{ 0 };
+			// Since Start, busy time over the time all workers existed
+			long long UptimeNanoseconds{ 0 };
+			float Utilisation{ 0 };
+			Histogram WaitTime;
+			Histogram RunTime;
+			std::vector<WorkerStats> PerWorker;
+		};
+
+		// Counters are relaxed and only written by their worker, so they
+		// stay on in every build. A snapshot can be a task behind
+		Stats GetStats() const;
+		// Tasks created since startup by every pool, flat once the free lists are warm
+		static uint64_t TasksAllocated();
+		size_t GetWorkerCount() const { return m_Workers.size(); }
+		const std::string& GetName() const { return m_Name; }
 	private:
-		void _ThreadWork(bool StartingSync = false);
+		struct Task
+		{
+			// The callable, or a pointer to it when it doesn't fit
+			alignas(std::max_align_t) unsigned char Storage[InlineTaskSize];
+			void (*Invoke)(Task& task){ nullptr };
+			void (*Destroy)(Task& task){ nullptr };
+			CancellationToken Token;
+			int Priority{ DefaultPriority };
+			uint64_t Sequence{ 0 };
+			// Tasks queued before the last cancel are dropped when taken
+			uint64_t Generation{ 0 };
+			Time::TimePoint Queued;
+			// Free list link
+			Task* Next{ nullptr };
+		};
+
+		// Free tasks of one thread, see ThreadPool.cpp
+		struct TaskCache;
+
+		struct Worker
+		{
+			WorkStealingDeque<Task*> Deque;
+			std::thread Thread;
+			uint32_t Seed{ 0 };
+			// Only written by the worker itself
+			std::atomic<uint64_t> TasksQueued{ 0 };
+			std::atomic<uint64_t> TasksRun{ 0 };
+			std::atomic<uint64_t> TasksCancelled{ 0 };
+			std::atomic<long long> BusyNanoseconds{ 0 };
+			std::atomic<long long> ParkedNanoseconds{ 0 };
+			// Clock time the current park started at, 0 while awake
+			std::atomic<long long> ParkedSince{ 0 };
+			std::atomic<uint64_t> WaitBuckets[Histogram::Buckets]{};
+			std::atomic<uint64_t> RunBuckets[Histogram::Buckets]{};
+		};
+
+		template<typename F>
+		static void _Call(F& f, const CancellationToken& token)
+		{
+			if constexpr (std::is_invocable_v<F&, const CancellationToken&>)
+			{
+				f(token);
+			}
+			else
+			{
+				f();
+			}
+		}
+
+		template<typename F>
+		void _Queue(F&& f, int priority, CancellationToken token, bool prioritised)
+		{
+			using Callable = std::decay_t<F>;
+
+			Task* task = _AllocateTask();
+			if constexpr (sizeof(Callable) <= InlineTaskSize && alignof(Callable) <= alignof(std::max_align_t))
+			{
+				new (task->Storage) Callable(std::forward<F>(f));
+				task->Invoke = [](Task& t) { _Call(*std::launder(reinterpret_cast<Callable*>(t.Storage)), t.Token); };
+				task->Destroy = [](Task& t) { std::launder(reinterpret_cast<Callable*>(t.Storage))->~Callable(); };
+			}
+			else
+			{
+				new (task->Storage) Callable*(new Callable(std::forward<F>(f)));
+				task->Invoke = [](Task& t) { _Call(**std::launder(reinterpret_cast<Callable**>(t.Storage)), t.Token); };
+				task->Destroy = [](Task& t) { delete *std::launder(reinterpret_cast<Callable**>(t.Storage)); };
+			}
+			task->Token = std::move(token);
+			task->Priority = priority;
+
+			_Submit(task, prioritised);
+		}
+
+		// A task dropped before it ran destroys its promise, the future gets broken_promise
+		template<typename F>
+		std::future<void> _QueueWithFuture(F&& f, int priority, CancellationToken token, bool prioritised)
+		{
+			std::promise<void> promise;
+			auto r = promise.get_future();
+			_Queue([f = std::forward<F>(f), promise = std::move(promise)](const CancellationToken& token) mutable
+				{
+					try
+					{
+						_Call(f, token);
+						promise.set_value();
+					}
+					catch (...)
+					{
+						promise.set_exception(std::current_exception());
+					}
+				}, priority, std::move(token), prioritised);
+			return r;
+		}
+
+		static Task* _AllocateTask();
+		// Destroys the callable and puts the task on the calling thread's free list
+		static void _ReleaseTask(Task* task);
+		static TaskCache& _LocalCache();
+
+		void _Launch(size_t N, bool StartingSync);
+		void _Submit(Task* task, bool prioritised);
+		void _ThreadWork(size_t index, bool StartingSync);
+		Task* _FindTask(Worker& self);
+		Task* _TakeInjected();
+		void _Run(Worker& self, Task* task);
+		void _Wake();
+
+		VoidCallback m_StartCallback, m_EndCallback;
+		std::vector<Ptr<Worker>> m_Workers;
+		std::string m_Name{ "pool" };
+		bool m_Pin{ false };
+		int m_FirstCore{ 0 };
+		Time::TimePoint m_StartTime;
+
+		std::mutex m_InjectMutex;
+		// Heap ordered by priority then sequence
+		std::vector<Task*> m_Injected;
+		uint64_t m_NextSequence{ 0 };
+		// Lets workers skip the injection lock when it's empty
+		std::atomic<size_t> m_InjectedCount{ 0 };
+
+		// Tasks queued but not taken yet, anywhere in the pool
+		std::atomic<size_t> m_Pending{ 0 };
+		std::atomic<size_t> m_PendingHighWater{ 0 };
+		// Counted here since they don't come from a worker
+		std::atomic<uint64_t> m_ExternalQueued{ 0 };
+		std::atomic<uint64_t> m_Dropped{ 0 };
+		std::atomic<uint64_t> m_Generation{ 0 };
+		std::atomic<bool> m_Stopping{ false };
+
+		std::mutex m_ParkMutex;
+		std::condition_variable m_Parked;
+		std::atomic<int> m_Sleeping{ 0 };
+
 		std::mutex m_StartMut;
 		std::condition_variable m_AllThreadsStarted;
-		int m_StartedThreads{ 0 };
-		VoidCallback m_StartCallback, m_EndCallback;
-		std::mutex m_M;
-		std::condition_variable m_Signal;
-		std::deque<std::packaged_task<void()>> m_Queue;
-		std::vector<std::future<void>> m_RunningThreads;
+		size_t m_StartedThreads{ 0 };
 	};
-}
\ No newline at end of file
+}
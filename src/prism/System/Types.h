@@ -1,5 +1,6 @@
 #pragma once
 #include <functional>
+#include <future>
 
 namespace Prism::System
 {
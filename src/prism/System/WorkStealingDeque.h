@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Prism::System
+{
+	// Chase-Lev deque (with the memory orders from Le et al. 2013). The owning
+	// thread pushes and pops at the bottom, any thread steals from the top.
+	// T has to be trivially copyable, the pool stores task pointers.
+	// Grown buffers are kept until destruction since thieves may still read them
+	template<typename T>
+	class WorkStealingDeque
+	{
+	public:
+		WorkStealingDeque(size_t capacity = 256)
+			:
+			m_Buffer(new Buffer(capacity))
+		{
+			m_Buffers.emplace_back(m_Buffer.load(std::memory_order_relaxed));
+		}
+
+		WorkStealingDeque(const WorkStealingDeque&) = delete;
+		WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+		// Owner only
+		void Push(T item)
+		{
+			const int64_t b = m_Bottom.load(std::memory_order_relaxed);
+			const int64_t t = m_Top.load(std::memory_order_acquire);
+			Buffer* buffer = m_Buffer.load(std::memory_order_relaxed);
+
+			if (b - t > static_cast<int64_t>(buffer->Mask))
+			{
+				buffer = _Grow(buffer, t, b);
+			}
+
+			buffer->Put(b, item);
+			std::atomic_thread_fence(std::memory_order_release);
+			m_Bottom.store(b + 1, std::memory_order_relaxed);
+		}
+
+		// Owner only, takes the newest item
+		bool Pop(T& item)
+		{
+			const int64_t b = m_Bottom.load(std::memory_order_relaxed) - 1;
+			Buffer* buffer = m_Buffer.load(std::memory_order_relaxed);
+			m_Bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = m_Top.load(std::memory_order_relaxed);
+
+			if (t > b)
+			{
+				m_Bottom.store(b + 1, std::memory_order_relaxed);
+				return false;
+			}
+
+			item = buffer->Get(b);
+			if (t == b)
+			{
+				// Last item, race the thieves for it
+				const bool won = m_Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				m_Bottom.store(b + 1, std::memory_order_relaxed);
+				return won;
+			}
+			return true;
+		}
+
+		// Any thread, takes the oldest item. Can fail spuriously when racing another thief
+		bool Steal(T& item)
+		{
+			int64_t t = m_Top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t b = m_Bottom.load(std::memory_order_acquire);
+
+			if (t >= b)
+			{
+				return false;
+			}
+
+			Buffer* buffer = m_Buffer.load(std::memory_order_acquire);
+			item = buffer->Get(t);
+			return m_Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+
+		size_t SizeApprox() const
+		{
+			const int64_t b = m_Bottom.load(std::memory_order_relaxed);
+			const int64_t t = m_Top.load(std::memory_order_relaxed);
+			return b > t ? static_cast<size_t>(b - t) : 0;
+		}
+	private:
+		struct Buffer
+		{
+			size_t Mask;
+			std::unique_ptr<std::atomic<T>[]> Items;
+
+			// Capacity is rounded up to a power of two
+			Buffer(size_t capacity)
+			{
+				size_t size = 1;
+				while (size < capacity)
+				{
+					size <<= 1;
+				}
+				Mask = size - 1;
+				Items.reset(new std::atomic<T>[size]);
+			}
+
+			T Get(int64_t i) const { return Items[i & Mask].load(std::memory_order_relaxed); }
+			void Put(int64_t i, T item) { Items[i & Mask].store(item, std::memory_order_relaxed); }
+		};
+
+		Buffer* _Grow(Buffer* buffer, int64_t top, int64_t bottom)
+		{
+			Buffer* grown = new Buffer((buffer->Mask + 1) * 2);
+			for (int64_t i = top; i < bottom; i++)
+			{
+				grown->Put(i, buffer->Get(i));
+			}
+			m_Buffers.emplace_back(grown);
+			m_Buffer.store(grown, std::memory_order_release);
+			return grown;
+		}
+
+		// Top and bottom on their own lines, thieves hammer top while the owner works the bottom
+		alignas(64) std::atomic<int64_t> m_Top{ 0 };
+		alignas(64) std::atomic<int64_t> m_Bottom{ 0 };
+		alignas(64) std::atomic<Buffer*> m_Buffer;
+		std::vector<std::unique_ptr<Buffer>> m_Buffers;
+	};
+}
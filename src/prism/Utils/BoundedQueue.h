@@ -0,0 +1,362 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace Prism::Utils
+{
+	// What Put does when the queue is full
+	enum class Backpressure
+	{
+		// Wait for a free cell
+		BLOCK = 0,
+		// Give up and return false
+		REJECT,
+		// Evict the oldest item to make room, for data where only the latest matters
+		DROP_OLDEST
+	};
+
+	// Bounded lock free multi producer multi consumer queue (Vyukov). Every
+	// cell carries a sequence number telling whether it is free for the
+	// producer of a ticket or full for its consumer, so producers and
+	// consumers only contend on their own position counter. The Try
+	// variants never block, the others spin briefly and then sleep, the
+	// mutex is only taken by threads that went to sleep and the ones waking them
+	template<typename T>
+	class BoundedQueue
+	{
+	public:
+		// Capacity is rounded up to a power of two
+		BoundedQueue(size_t capacity, Backpressure policy = Backpressure::BLOCK)
+			:
+			m_Policy(policy)
+		{
+			size_t size = 2;
+			while (size < capacity)
+			{
+				size <<= 1;
+			}
+
+			m_Mask = size - 1;
+			m_Cells = new Cell[size];
+			for (size_t i = 0; i < size; i++)
+			{
+				m_Cells[i].Sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		~BoundedQueue()
+		{
+			T item;
+			while (TryGet(item))
+			{
+			}
+			delete[] m_Cells;
+		}
+
+		BoundedQueue(const BoundedQueue&) = delete;
+		BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+		size_t Capacity() const { return m_Mask + 1; }
+		Backpressure GetPolicy() const { return m_Policy; }
+
+		// Can be off while producers and consumers are running
+		size_t SizeApprox() const
+		{
+			const size_t tail = m_Tail.load(std::memory_order_relaxed);
+			const size_t head = m_Head.load(std::memory_order_relaxed);
+			return head > tail ? head - tail : 0;
+		}
+
+		template<typename U>
+		bool TryPut(U&& item)
+		{
+			if (m_Finished.load(std::memory_order_relaxed))
+			{
+				return false;
+			}
+
+			if (!_TryPush(std::forward<U>(item)))
+			{
+				return false;
+			}
+			_Notify(m_WaitingConsumers, m_NotEmpty);
+			return true;
+		}
+
+		bool TryGet(T& item)
+		{
+			if (!_TryPop(item))
+			{
+				return false;
+			}
+			_Notify(m_WaitingProducers, m_NotFull);
+			return true;
+		}
+
+		// Follows the policy when full. False once finished or when rejected
+		template<typename U>
+		bool Put(U&& item)
+		{
+			return _Put(std::forward<U>(item), nullptr);
+		}
+
+		// Like Put but a blocking policy gives up after timeout
+		template<typename U, typename Rep, typename Period>
+		bool Put(U&& item, const std::chrono::duration<Rep, Period>& timeout)
+		{
+			const auto deadline = std::chrono::steady_clock::now() + timeout;
+			return _Put(std::forward<U>(item), &deadline);
+		}
+
+		// Waits for an item. False once finished and drained
+		bool Get(T& item)
+		{
+			return _Get(item, nullptr);
+		}
+
+		// False on timeout as well
+		template<typename Rep, typename Period>
+		bool Get(T& item, const std::chrono::duration<Rep, Period>& timeout)
+		{
+			const auto deadline = std::chrono::steady_clock::now() + timeout;
+			return _Get(item, &deadline);
+		}
+
+		// Refuses new items and wakes every waiter, consumers keep getting
+		// what is left. Unlike SyncQueue it does not wait for the queue to drain
+		void Finish()
+		{
+			{
+				std::lock_guard<std::mutex> lck(m_Mutex);
+				m_Finished.store(true);
+			}
+			m_NotEmpty.notify_all();
+			m_NotFull.notify_all();
+		}
+
+		bool IsFinished() const { return m_Finished.load(); }
+	private:
+		using Deadline = std::chrono::steady_clock::time_point;
+		static constexpr size_t CacheLine = 64;
+		static constexpr int SpinCount = 64;
+
+		struct alignas(CacheLine) Cell
+		{
+			std::atomic<size_t> Sequence;
+			alignas(T) unsigned char Storage[sizeof(T)];
+
+			T* Item() { return std::launder(reinterpret_cast<T*>(Storage)); }
+		};
+
+		template<typename U>
+		bool _TryPush(U&& item)
+		{
+			size_t pos = m_Head.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				Cell& cell = m_Cells[pos & m_Mask];
+				const size_t seq = cell.Sequence.load(std::memory_order_acquire);
+				const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+				if (diff == 0)
+				{
+					if (m_Head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						new (cell.Storage) T(std::forward<U>(item));
+						cell.Sequence.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				// The consumer of the previous lap has not taken the item yet
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					pos = m_Head.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		bool _TryPop(T& item)
+		{
+			size_t pos = m_Tail.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				Cell& cell = m_Cells[pos & m_Mask];
+				const size_t seq = cell.Sequence.load(std::memory_order_acquire);
+				const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+
+				if (diff == 0)
+				{
+					if (m_Tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						T* stored = cell.Item();
+						item = std::move(*stored);
+						stored->~T();
+						cell.Sequence.store(pos + m_Mask + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				// Empty, or the producer of this cell is still writing
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					pos = m_Tail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		template<typename U>
+		bool _Put(U&& item, const Deadline* deadline)
+		{
+			if (TryPut(std::forward<U>(item)))
+			{
+				return true;
+			}
+
+			switch (m_Policy)
+			{
+			case Backpressure::REJECT:
+				return false;
+			case Backpressure::DROP_OLDEST:
+			{
+				T evicted;
+				while (!m_Finished.load(std::memory_order_relaxed))
+				{
+					// Whatever happens to the evicted item, a cell was freed or taken by a consumer
+					_TryPop(evicted);
+					if (TryPut(std::forward<U>(item)))
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+			default:
+				if (!_Wait(m_WaitingProducers, m_NotFull, deadline,
+					[&] { return !m_Finished.load(std::memory_order_relaxed) && _TryPush(std::forward<U>(item)); },
+					[&] { return m_Finished.load(std::memory_order_relaxed); }))
+				{
+					return false;
+				}
+				_Notify(m_WaitingConsumers, m_NotEmpty);
+				return true;
+			}
+		}
+
+		bool _Get(T& item, const Deadline* deadline)
+		{
+			if (TryGet(item))
+			{
+				return true;
+			}
+			// Claimed cells are still drained after the finish, their producers are about to publish them
+			if (!_Wait(m_WaitingConsumers, m_NotEmpty, deadline,
+				[&] { return _TryPop(item); },
+				[&] { return m_Finished.load(std::memory_order_relaxed) && SizeApprox() == 0; }))
+			{
+				return false;
+			}
+			_Notify(m_WaitingProducers, m_NotFull);
+			return true;
+		}
+
+		// Retries attempt until it succeeds, stop holds or the deadline passes.
+		// Attempt must not notify, it runs under the mutex _Notify takes
+		template<typename Attempt, typename Stop>
+		bool _Wait(std::atomic<int>& waiting, std::condition_variable& signal, const Deadline* deadline, Attempt&& attempt, Stop&& stop)
+		{
+			for (int i = 0; i < SpinCount; i++)
+			{
+				if (attempt())
+				{
+					return true;
+				}
+				if (stop() || (deadline && std::chrono::steady_clock::now() >= *deadline))
+				{
+					return false;
+				}
+				std::this_thread::yield();
+			}
+
+			std::unique_lock<std::mutex> lck(m_Mutex);
+			waiting.fetch_add(1);
+			// Pairs with the fence in _Notify, either the other side sees the
+			// waiter or the retry below sees its item or cell
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			bool done = false;
+			for (;;)
+			{
+				if (attempt())
+				{
+					done = true;
+					break;
+				}
+				if (stop())
+				{
+					break;
+				}
+
+				if (deadline)
+				{
+					if (signal.wait_until(lck, *deadline) == std::cv_status::timeout)
+					{
+						done = attempt();
+						break;
+					}
+				}
+				else
+				{
+					signal.wait(lck);
+				}
+			}
+
+			waiting.fetch_sub(1);
+			return done;
+		}
+
+		void _Notify(std::atomic<int>& waiting, std::condition_variable& signal)
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (waiting.load(std::memory_order_relaxed) > 0)
+			{
+				// Taking the lock makes sure the waiter is inside wait and not between its retry and wait
+				{
+					std::lock_guard<std::mutex> lck(m_Mutex);
+				}
+				signal.notify_one();
+			}
+		}
+
+		static_assert(std::is_default_constructible_v<T>, "BoundedQueue items are moved out into a T");
+
+		Cell* m_Cells{ nullptr };
+		size_t m_Mask{ 0 };
+		Backpressure m_Policy;
+
+		// Producers and consumers each get their own line
+		alignas(CacheLine) std::atomic<size_t> m_Head{ 0 };
+		alignas(CacheLine) std::atomic<size_t> m_Tail{ 0 };
+
+		alignas(CacheLine) std::atomic<bool> m_Finished{ false };
+		std::atomic<int> m_WaitingProducers{ 0 };
+		std::atomic<int> m_WaitingConsumers{ 0 };
+		std::mutex m_Mutex;
+		std::condition_variable m_NotEmpty;
+		std::condition_variable m_NotFull;
+	};
+}
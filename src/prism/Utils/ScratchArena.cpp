@@ -0,0 +1,75 @@
+#include "ScratchArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace Prism::Utils
+{
+	ScratchArena& ScratchArena::ForThread()
+	{
+		thread_local ScratchArena arena;
+		return arena;
+	}
+
+	void* ScratchArena::Allocate(size_t bytes, size_t alignment)
+	{
+		for (;;)
+		{
+			if (m_Current == m_Blocks.size())
+			{
+				// Blocks start aligned for any scalar, the padding covers larger requests
+				Block block;
+				block.Size = std::max(BlockSize, bytes + alignment);
+				block.Data = std::make_unique<std::byte[]>(block.Size);
+				m_Reserved += block.Size;
+				m_Usage.HeapBytes += block.Size;
+				m_Blocks.push_back(std::move(block));
+			}
+
+			auto& block = m_Blocks[m_Current];
+			const auto base = reinterpret_cast<uintptr_t>(block.Data.get());
+			const size_t offset = ((base + m_Offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+			if (offset + bytes <= block.Size)
+			{
+				m_Offset = offset + bytes;
+				m_Usage.ArenaBytes += bytes;
+				return block.Data.get() + offset;
+			}
+
+			// Blocks past the current one are free, one too small for
+			// the request is replaced by a new one in the loop
+			m_Current++;
+			m_Offset = 0;
+			if (m_Current < m_Blocks.size() && m_Blocks[m_Current].Size < bytes + alignment)
+			{
+				m_Reserved -= m_Blocks[m_Current].Size;
+				m_Blocks.erase(m_Blocks.begin() + m_Current);
+			}
+		}
+	}
+
+	void ScratchArena::Deallocate(void* ptr, size_t bytes)
+	{
+		if (m_Current == m_Blocks.size())
+		{
+			return;
+		}
+
+		std::byte* top = m_Blocks[m_Current].Data.get() + m_Offset;
+		if (static_cast<std::byte*>(ptr) + bytes == top)
+		{
+			m_Offset -= bytes;
+		}
+	}
+
+	void* ScratchArena::AllocateHeap(size_t bytes)
+	{
+		m_Usage.HeapBytes += bytes;
+		return ::operator new(bytes);
+	}
+
+	void ScratchArena::DeallocateHeap(void* ptr)
+	{
+		::operator delete(ptr);
+	}
+}
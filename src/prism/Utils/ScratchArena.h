@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace Prism::Utils
+{
+	// Per thread bump allocator for the short lived buffers of a job: sample
+	// tiles, noise registers, meshing masks. Scratch is carved out of blocks
+	// the thread keeps, so once they are there it never goes through the
+	// global heap and the workers don't contend on it. Memory is given back
+	// when a ScratchScope ends, which rewinds the arena in O(1)
+	class ScratchArena
+	{
+	public:
+		static constexpr size_t BlockSize = 64 * 1024;
+
+		// Scratch bytes served from the blocks and bytes that came from the
+		// heap, new blocks and allocations made outside of any scope
+		struct Usage
+		{
+			size_t ArenaBytes{ 0 };
+			size_t HeapBytes{ 0 };
+
+			Usage& operator+=(const Usage& other)
+			{
+				ArenaBytes += other.ArenaBytes;
+				HeapBytes += other.HeapBytes;
+				return *this;
+			}
+		};
+
+		ScratchArena() = default;
+		ScratchArena(const ScratchArena&) = delete;
+		ScratchArena& operator=(const ScratchArena&) = delete;
+
+		// Arena of the calling thread
+		static ScratchArena& ForThread();
+
+		void* Allocate(size_t bytes, size_t alignment);
+		// Only the latest allocation is given back right away, the rest waits for the scope
+		void Deallocate(void* ptr, size_t bytes);
+
+		void* AllocateHeap(size_t bytes);
+		void DeallocateHeap(void* ptr);
+
+		bool InScope() const { return m_Depth > 0; }
+		const Usage& GetUsage() const { return m_Usage; }
+		// Bytes held by the blocks, kept until the thread exits
+		size_t GetReserved() const { return m_Reserved; }
+	private:
+		friend class ScratchScope;
+
+		struct Block
+		{
+			std::unique_ptr<std::byte[]> Data;
+			size_t Size{ 0 };
+		};
+
+		std::vector<Block> m_Blocks;
+		// Allocations go on at m_Offset in m_Blocks[m_Current]
+		size_t m_Current{ 0 };
+		size_t m_Offset{ 0 };
+		size_t m_Reserved{ 0 };
+		int m_Depth{ 0 };
+		Usage m_Usage;
+	};
+
+	// Everything taken from the thread's arena while the scope lives is
+	// released when it ends, scopes nest. Scratch containers are declared
+	// after their scope and must not outlive it. A scope ends on the thread
+	// it began on, so it never spans a co_await that can hop threads
+	class ScratchScope
+	{
+	public:
+		ScratchScope()
+			:
+			m_Arena(ScratchArena::ForThread()),
+			m_Current(m_Arena.m_Current),
+			m_Offset(m_Arena.m_Offset),
+			m_Start(m_Arena.m_Usage)
+		{
+			m_Arena.m_Depth++;
+		}
+
+		~ScratchScope()
+		{
+			m_Arena.m_Depth--;
+			m_Arena.m_Current = m_Current;
+			m_Arena.m_Offset = m_Offset;
+		}
+
+		ScratchScope(const ScratchScope&) = delete;
+		ScratchScope& operator=(const ScratchScope&) = delete;
+
+		// Scratch taken since the scope began, nested scopes included
+		ScratchArena::Usage GetUsage() const
+		{
+			const auto& now = m_Arena.m_Usage;
+			return { now.ArenaBytes - m_Start.ArenaBytes, now.HeapBytes - m_Start.HeapBytes };
+		}
+	private:
+		ScratchArena& m_Arena;
+		size_t m_Current;
+		size_t m_Offset;
+		ScratchArena::Usage m_Start;
+	};
+
+	// STL allocator on the thread's arena. Inside a scope it binds to the
+	// arena, outside of one it falls back to the heap, so a container
+	// created without a scope still works, it just isn't scratch
+	template<typename T>
+	class ArenaAllocator
+	{
+	public:
+		static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "(ArenaAllocator) Over aligned type");
+
+		using value_type = T;
+
+		ArenaAllocator() noexcept
+		{
+			auto& arena = ScratchArena::ForThread();
+			m_Arena = arena.InScope() ? &arena : nullptr;
+		}
+
+		template<typename U>
+		ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+			:
+			m_Arena(other.GetArena())
+		{}
+
+		T* allocate(size_t n)
+		{
+			if (m_Arena)
+			{
+				return static_cast<T*>(m_Arena->Allocate(n * sizeof(T), alignof(T)));
+			}
+			return static_cast<T*>(ScratchArena::ForThread().AllocateHeap(n * sizeof(T)));
+		}
+
+		void deallocate(T* ptr, size_t n) noexcept
+		{
+			if (m_Arena)
+			{
+				m_Arena->Deallocate(ptr, n * sizeof(T));
+				return;
+			}
+			ScratchArena::ForThread().DeallocateHeap(ptr);
+		}
+
+		ScratchArena* GetArena() const noexcept { return m_Arena; }
+
+		template<typename U>
+		bool operator==(const ArenaAllocator<U>& other) const noexcept
+		{
+			return m_Arena == other.GetArena();
+		}
+	private:
+		ScratchArena* m_Arena{ nullptr };
+	};
+
+	template<typename T>
+	using ScratchVector = std::vector<T, ArenaAllocator<T>>;
+}
@@ -1,48 +1,44 @@
 #include "Chunk.h"
 
+#include <algorithm>
+
 
 #include "glm/ext/matrix_transform.hpp"
 #include "prism/Math/Interpolation.h"
 #include "prism/Math/Smoothing.h"
+#include "prism/System/ByteStream.h"
 #include "prism/System/ScopeTimer.h"
 
-namespace std
-{
-	// TEMPPPP!!!
-	template<> struct hash<Prism::Voxel::Vec2>
-	{
-		size_t operator()(const Prism::Voxel::Vec2& vec) const noexcept
-		{
-			hash<float> hasher;
-			auto a = hasher(vec.x);
-			auto b = hasher(vec.y);
-			// (a ^ b) >> 2
-			//return b + 0x9e3779b9 + (a << 6) + (a >> 2);
-			return b + 0x9e3779b9 + (a << 6) + (a >> 2);
-		}
-	};
-}
-
 namespace Prism::Voxel
 {
-	Chunk::Chunk(int Size, int blockSize)
+	Chunk::Chunk(int Size, int blockSize, VertexFormat format)
 		:
+		m_VertexFormat(format),
+		m_Size(Size),
+		m_BaseBlockSize(blockSize),
 		m_BlockSize(blockSize),
 		m_XSize(Size),
 		m_YSize(Size),
 		m_ZSize(Size)
 	{
-		m_Mesh = MakePtr<MeshType>();
-
+		if (m_VertexFormat == VertexFormat::PACKED)
+		{
+			// Top faces sit one above the column, so corners go up to Size + 1 and have to fit in 7 bits
+			PR_ASSERT(Size < PackedMaxSize, "(Chunk) Chunk too big for the packed vertex format");
+			m_PackedMesh = MakePtr<Renderer::PackedQuadMesh>();
+		}
+		else
+		{
+			m_Mesh = MakePtr<MeshType>();
 
-		m_NormalBuffer = m_Mesh->CreateNewVertexBuffer({
-			{ Gl::ShaderDataType::Float3, "normal" }
-		});
+			m_NormalBuffer = m_Mesh->CreateNewVertexBuffer({
+				{ Gl::ShaderDataType::Float3, "normal" }
+			});
 
-		m_ColorBuffer = m_Mesh->CreateNewVertexBuffer({
-			{ Gl::ShaderDataType::Float3, "color" }
-		});
-		m_MeshReady = MakePtr<std::atomic_bool>();
+			m_ColorBuffer = m_Mesh->CreateNewVertexBuffer({
+				{ Gl::ShaderDataType::Float3, "color" }
+			});
+		}
 	}
 
 	// Allocation is in another function in order to
@@ -55,8 +51,8 @@ namespace Prism::Voxel
 		}
 
 		size_t total = m_XSize* m_ZSize* m_YSize;
-		m_Blocks.resize(total);
-		m_BlockHeights.resize(m_XSize * m_ZSize, 0);
+		m_Blocks.Resize(total, BlockType::NONE);
+		m_BlockHeights.resize((m_XSize + 2) * (m_ZSize + 2), 0);
 
 
 		if constexpr (std::is_same_v<MeshType, Renderer::AllocatedMesh>)
@@ -70,12 +66,12 @@ namespace Prism::Voxel
 		}
 		
 		m_IsAllocated = true;
-		*m_MeshReady = false;
+		m_MeshReady = false;
 	}
 
-	void Chunk::SetPopulationFunction(std::function<float(int, int)> PopFunc)
+	void Chunk::SetHeightSource(Ref<const IHeightSource> source)
 	{
-		m_PopulationFunction = PopFunc;
+		m_HeightSource = std::move(source);
 	}
 
 	void Chunk::SetMappingFunction(std::function<void()> MapFunc)
@@ -85,61 +81,258 @@ namespace Prism::Voxel
 	
 	void Chunk::Populate()
 	{
-		PR_ASSERT(m_PopulationFunction, "(Chunk) No population function present!");
-		System::Time::Scope<System::Time::Miliseconds> RandomTimer("Chunk Population");
-		*m_MeshReady = false;
-		int ySize = m_YSize - 1;
-		int zOffset = m_ZSize * m_YOffset;
-		int xOffset = m_XSize * m_XOffset;
+		PR_ASSERT(m_HeightSource, "(Chunk) No height source present!");
+		Populate(*m_HeightSource);
+	}
+
+	void Chunk::_PopulateFromSamples(const float* samples)
+	{
+		m_MeshReady = false;
+		m_Blocks.Fill(BlockType::NONE);
+
+		// The halo ring comes along in the same region, so meshing never has to
+		// go back to the source. Corners are never read while meshing
+		for (size_t i = 0; i < m_BlockHeights.size(); i++)
+		{
+			m_BlockHeights[i] = _ToHeight(samples[i]);
+		}
+
 		for (int x = 0; x < m_XSize; x++)
 		{
-			int xTranslated = x + xOffset;
 			for (int z = 0; z < m_ZSize; z++)
 			{
-				int height = ceil(m_PopulationFunction(xTranslated, z + zOffset) * ySize);
-				height = glm::clamp(height, 0, m_YSize);
-				for (int i = 0; i < height; i++)
+				m_Blocks.FillRun(_GetBlockLoc(x, z, 0), m_BlockHeights[_GetLoc(x, z)], BlockType::BLOCK);
+			}
+		}
+
+		_FinishHeights();
+	}
+
+	// Layout, varints are LEB128 and signed ones zigzag encoded:
+	//  u8 skirt mask the halo was saved with
+	//  varint size, varint lod
+	//  varint height count, heights as signed deltas from the previous one
+	//  varint palette size, palette entries
+	//  (varint palette index, varint length) runs until every block is covered
+	static constexpr uint64_t MaxPaletteSize = 1 << PalettedContainer<Chunk::BlockType>::MaxBits;
+
+	void Chunk::Serialize(std::vector<uint8_t>& out) const
+	{
+		System::ByteWriter w(out);
+		w.U8(m_SkirtMask);
+		w.VarU(m_XSize);
+		w.VarU(m_Lod);
+
+		w.VarU(m_BlockHeights.size());
+		int previous = 0;
+		for (int height : m_BlockHeights)
+		{
+			w.VarI(height - previous);
+			previous = height;
+		}
+
+		const auto& palette = m_Blocks.GetPalette();
+		w.VarU(palette.size());
+		for (auto entry : palette)
+		{
+			w.VarU(static_cast<uint64_t>(entry));
+		}
+
+		for (size_t i = 0; i < m_Blocks.Size();)
+		{
+			const auto value = m_Blocks.Get(i);
+			const size_t length = m_Blocks.RunLength(i, m_Blocks.Size() - i);
+			w.VarU(std::find(palette.begin(), palette.end(), value) - palette.begin());
+			w.VarU(length);
+			i += length;
+		}
+	}
+
+	bool Chunk::Deserialize(const uint8_t* data, size_t size)
+	{
+		System::ByteReader r(data, size);
+		const uint8_t savedSkirts = r.U8();
+		if (r.VarU() != static_cast<uint64_t>(m_XSize) || r.VarU() != static_cast<uint64_t>(m_Lod) || r.VarU() != m_BlockHeights.size())
+		{
+			return false;
+		}
+
+		int previous = 0;
+		for (auto& height : m_BlockHeights)
+		{
+			height = glm::clamp(previous + static_cast<int>(r.VarI()), 0, m_YSize);
+			previous = height;
+		}
+
+		// Counts come from disk, a corrupt one must not turn into a huge allocation.
+		// Every entry takes at least a byte
+		const uint64_t paletteSize = r.VarU();
+		if (r.Failed() || paletteSize > MaxPaletteSize || paletteSize > r.Remaining())
+		{
+			return false;
+		}
+
+		// Materials end up in 8 bits of the vertex and the greedy masks
+		std::vector<BlockType> palette(paletteSize);
+		for (auto& entry : palette)
+		{
+			const uint64_t value = r.VarU();
+			if (value >= static_cast<uint64_t>(BlockType::COUNT))
+			{
+				return false;
+			}
+			entry = static_cast<BlockType>(value);
+		}
+
+		m_Blocks.Fill(BlockType::NONE);
+		for (size_t i = 0; i < m_Blocks.Size() && !r.Failed();)
+		{
+			const uint64_t index = r.VarU();
+			const uint64_t length = r.VarU();
+			if (index >= palette.size() || length == 0 || length > m_Blocks.Size() - i)
+			{
+				return false;
+			}
+			m_Blocks.FillRun(i, length, palette[index]);
+			i += length;
+		}
+
+		if (r.Failed())
+		{
+			return false;
+		}
+
+		// Skirted sides were saved flattened, they need the real heights back
+		_SampleHalo(savedSkirts);
+		_FinishHeights();
+		m_MeshReady = false;
+		return true;
+	}
+
+	void Chunk::_SampleHalo(uint8_t sides)
+	{
+		if (!sides)
+		{
+			return;
+		}
+		PR_ASSERT(m_HeightSource, "(Chunk) No height source present!");
+
+		// One region per side, sample i of it lands at halo column (x + i * dx, z + i * dz)
+		struct Side { Face face; int x, z, dx, dz, count; };
+		const Side Sides[4] = {
+			{ Face::BACK, 0, -1, 1, 0, m_XSize },
+			{ Face::FRONT, 0, m_ZSize, 1, 0, m_XSize },
+			{ Face::RIGHT, -1, 0, 0, 1, m_ZSize },
+			{ Face::LEFT, m_XSize, 0, 0, 1, m_ZSize },
+		};
+
+		const HeightRegion halo = _HaloRegion();
+		Utils::ScratchScope scope;
+		Utils::ScratchVector<float> samples(std::max(m_XSize, m_ZSize));
+		for (auto& side : Sides)
+		{
+			if (!(sides & (1 << static_cast<int>(side.face))))
+			{
+				continue;
+			}
+
+			HeightRegion region;
+			region.X = halo.X + (side.x + 1) * halo.Step;
+			region.Z = halo.Z + (side.z + 1) * halo.Step;
+			region.Width = side.dx ? side.count : 1;
+			region.Height = side.dz ? side.count : 1;
+			region.Step = halo.Step;
+			m_HeightSource->FillRegion(region, samples.data());
+
+			for (int i = 0; i < side.count; i++)
+			{
+				m_BlockHeights[_GetLoc(side.x + i * side.dx, side.z + i * side.dz)] = _ToHeight(samples[i]);
+			}
+		}
+	}
+
+	void Chunk::_FinishHeights()
+	{
+		auto HasSkirt = [this](Face face) { return m_SkirtMask & (1 << static_cast<int>(face)); };
+		for (int x = 0; x < m_XSize; x++)
+		{
+			if (HasSkirt(Face::BACK)) m_BlockHeights[_GetLoc(x, -1)] = 0;
+			if (HasSkirt(Face::FRONT)) m_BlockHeights[_GetLoc(x, m_ZSize)] = 0;
+		}
+		for (int z = 0; z < m_ZSize; z++)
+		{
+			if (HasSkirt(Face::RIGHT)) m_BlockHeights[_GetLoc(-1, z)] = 0;
+			if (HasSkirt(Face::LEFT)) m_BlockHeights[_GetLoc(m_XSize, z)] = 0;
+		}
+
+		// Side faces reach down to the halo, so it bounds the mesh too
+		m_MinHeight = m_YSize;
+		m_MaxHeight = 0;
+		for (int x = -1; x <= m_XSize; x++)
+		{
+			for (int z = -1; z <= m_ZSize; z++)
+			{
+				const bool corner = (x == -1 || x == m_XSize) && (z == -1 || z == m_ZSize);
+				if (corner)
 				{
-					m_Blocks[_GetBlockLoc(x, z, i)].Type = BlockType::BLOCK;
+					continue;
 				}
-				m_BlockHeights[_GetLoc(x, z)] = height;
+
+				const int height = m_BlockHeights[_GetLoc(x, z)];
+				m_MinHeight = std::min(m_MinHeight, height);
+				m_MaxHeight = std::max(m_MaxHeight, height);
 			}
 		}
 	}
 
 	void Chunk::_CreateQuad(
+		Face face, BlockType material,
 		int v0x, int v0y, int v0z, 
 		int v1x, int v1y, int v1z, 
 		int v2x, int v2y, int v2z, 
 		int v3x, int v3y, int v3z)
 	{
-		glm::vec3 p0 = { v0x, v0y, v0z };
-		glm::vec3 p1 = { v1x, v1y, v1z };
-		glm::vec3 p2 = { v2x, v2y, v2z };
-		glm::vec3 p3 = { v3x, v3y, v3z };
+		if (m_VertexFormat == VertexFormat::PACKED)
+		{
+			m_PackedMesh->AddQuad(
+				_PackVertex(v0x, v0y, v0z, face, material),
+				_PackVertex(v1x, v1y, v1z, face, material),
+				_PackVertex(v2x, v2y, v2z, face, material),
+				_PackVertex(v3x, v3y, v3z, face, material)
+			);
+			return;
+		}
+
+		const float bs = static_cast<float>(m_BlockSize);
+		glm::vec3 p0 = glm::vec3{ v0x, v0y, v0z } * bs;
+		glm::vec3 p1 = glm::vec3{ v1x, v1y, v1z } * bs;
+		glm::vec3 p2 = glm::vec3{ v2x, v2y, v2z } * bs;
+		glm::vec3 p3 = glm::vec3{ v3x, v3y, v3z } * bs;
 
 		auto v0p = m_Mesh->AddVertex(p0);
 		auto v1p = m_Mesh->AddVertex(p1);
 		auto v2p = m_Mesh->AddVertex(p2);
 		auto v3p = m_Mesh->AddVertex(p3);
-		/*
-		auto v0p = m_Mesh->AddVertex(p0);
-		auto v1p = m_Mesh->AddVertex(p1);
-		auto v2p = m_Mesh->AddVertex(p2);
-		auto v3p = m_Mesh->AddVertex(p3);
-		*/
+		
 		glm::vec3 normal = glm::cross((p2 - p0), (p3 - p1));
 
-		/*
-		m_Mesh->ConnectVertices(v0p, v1p, v3p);
-		m_Mesh->ConnectVertices(v3p, v1p, v2p);
-		*/
-
 		m_Mesh->ConnectVertices(v0p, v1p, v3p);
 		m_Mesh->ConnectVertices(v3p, v1p, v2p);
 		_PassVertParam(m_NormalBuffer, normal);
+		_PassVertParam(m_ColorBuffer, _GetMaterialColor(material));
 		//_TexCord();
 	}
+
+	glm::vec3 Chunk::_GetMaterialColor(BlockType material)
+	{
+		// Keep in sync with the palette in voxel.vert
+		switch (material)
+		{
+		case BlockType::BLOCK:	return { 0.f, 0.8f, 0.1f };
+		case BlockType::DIRT:	return { 0.45f, 0.3f, 0.15f };
+		default:				return { 0.f, 0.f, 0.f };
+		}
+	}
 	
 	void Chunk::_PassVertParam(uint32_t buffer, const glm::vec3& param)
 	{
@@ -167,7 +360,7 @@ namespace Prism::Voxel
 		m_XOffset = x;
 		m_YOffset = y;
 		m_Position = glm::vec3{
-			x * (m_BlockSize * m_XSize - 2 * m_BlockSize),
+			x * m_BlockSize * m_XSize,
 			0.f,
 			y * m_BlockSize * m_ZSize
 		};
@@ -175,37 +368,657 @@ namespace Prism::Voxel
 		m_Transform = glm::translate(glm::mat4(1.f), m_Position);
 	}
 	
+	void Chunk::SetLod(int lod)
+	{
+		lod = glm::clamp(lod, 0, MaxLod(m_Size));
+		if (lod == m_Lod)
+		{
+			return;
+		}
+
+		m_Lod = lod;
+		m_XSize = m_Size >> lod;
+		m_YSize = m_Size >> lod;
+		m_ZSize = m_Size >> lod;
+		m_BlockSize = m_BaseBlockSize << lod;
+		m_IsAllocated = false;
+		m_MeshReady = false;
+	}
+
+	void Chunk::SetSkirtMask(uint8_t mask)
+	{
+		m_SkirtMask = mask;
+	}
+
 	void Chunk::SendToGpu()
 	{
 		if (m_DataSentToGpu)
 		{
 			return;
 		}
-		m_Mesh->Flush();
+		if (m_VertexFormat == VertexFormat::PACKED)
+		{
+			m_PackedMesh->Flush();
+		}
+		else
+		{
+			m_Mesh->Flush();
+		}
 
 		m_DataSentToGpu = true;
 	}
 
+	void Chunk::SendToGpu(const std::vector<Chunk*>& chunks)
+	{
+		uint32_t maxQuads = 0;
+		for (auto* chunk : chunks)
+		{
+			if (chunk->m_VertexFormat == VertexFormat::PACKED && !chunk->m_DataSentToGpu)
+			{
+				maxQuads = std::max(maxQuads, chunk->m_PackedMesh->GetQuadCount());
+			}
+		}
+		Renderer::PackedQuadMesh::ReserveSharedIndices(maxQuads);
+
+		for (auto* chunk : chunks)
+		{
+			chunk->SendToGpu();
+		}
+	}
+
 	void Chunk::Clear()
 	{
-		m_Blocks.clear();
+		m_Blocks.Clear();
 		m_BlockHeights.clear();
 	}
 
 	void Chunk::PrepareForClearing()
 	{
-		*m_MeshReady = false;
+		m_MeshReady = false;
+	}
+
+	void Chunk::Recycle()
+	{
+		// Blocks and gpu buffers are kept, the next Populate/GenerateMesh
+		// overwrite them and SendToGpu uploads again
+		m_MeshReady = false;
+		m_DataSentToGpu = false;
 	}
 
 	void Chunk::Render()
 	{
+		if (m_VertexFormat == VertexFormat::PACKED)
+		{
+			m_PackedMesh->DrawIndexed();
+			return;
+		}
 		m_Mesh->DrawIndexed();
 	}
+
+	size_t Chunk::GetMeshMemorySize() const
+	{
+		if (m_VertexFormat == VertexFormat::PACKED)
+		{
+			// Index data is shared between all packed meshes
+			return m_PackedMesh->GetMemorySize();
+		}
+		// position, normal and color streams
+		return m_Mesh->GetVertexCount() * 3 * sizeof(glm::vec3) + m_Mesh->GetElementCount() * sizeof(uint32_t);
+	}
 	
+	void Chunk::SetMeshingMode(MeshingMode mode)
+	{
+		m_MeshingMode = mode;
+	}
+
 	void Chunk::GenerateMesh()
 	{
 		System::Time::Scope<System::Time::Miliseconds> RandomTimer("Chunk Mesh Generation");
 
+		// Meshing can be repeated (mode switches, benchmarks), never append to a previous mesh
+		if (m_VertexFormat == VertexFormat::PACKED)
+		{
+			m_PackedMesh->NewMesh();
+		}
+		else
+		{
+			m_Mesh->NewMesh();
+		}
+
+		m_SectionsX = (m_XSize + SectionSize - 1) / SectionSize;
+		m_SectionsZ = (m_ZSize + SectionSize - 1) / SectionSize;
+		m_Sections.assign(m_SectionsX * m_SectionsZ, Section{});
+		m_DirtySections = 0;
+		m_UploadFirst = m_UploadEnd = 0;
+
+		for (int sz = 0; sz < m_SectionsZ; sz++)
+		{
+			for (int sx = 0; sx < m_SectionsX; sx++)
+			{
+				auto& section = m_Sections[sz * m_SectionsX + sx];
+				section.firstQuad = _GetQuadCount();
+				_GenerateSection(
+					sx * SectionSize, sz * SectionSize,
+					std::min((sx + 1) * SectionSize, m_XSize),
+					std::min((sz + 1) * SectionSize, m_ZSize)
+				);
+				section.quadCount = _GetQuadCount() - section.firstQuad;
+				section.capacity = section.quadCount;
+			}
+		}
+
+		m_MeshReady = true;
+	}
+
+	void Chunk::_GenerateSection(int x0, int z0, int x1, int z1)
+	{
+		if (m_MeshingMode == MeshingMode::GREEDY)
+		{
+			_GenerateGreedyMesh(x0, z0, x1, z1);
+		}
+		else
+		{
+			_GeneratePerFaceMesh(x0, z0, x1, z1);
+		}
+	}
+
+	uint32_t Chunk::_GetQuadCount() const
+	{
+		if (m_VertexFormat == VertexFormat::PACKED)
+		{
+			return m_PackedMesh->GetQuadCount();
+		}
+		return m_Mesh->GetVertexCount() / 4;
+	}
+
+	bool Chunk::SetBlock(int x, int level, int z, BlockType type)
+	{
+		if (type == BlockType::NONE)
+		{
+			return RemoveBlock(x, level, z);
+		}
+
+		// The top face sits one level above the column and has to stay packable
+		if (x < 0 || x >= m_XSize || z < 0 || z >= m_ZSize || level < 1 || level >= m_YSize)
+		{
+			return false;
+		}
+
+		int& height = m_BlockHeights[_GetLoc(x, z)];
+		if (level <= height)
+		{
+			if (m_Blocks.Get(_GetBlockLoc(x, z, level - 1)) == type)
+			{
+				return false;
+			}
+			m_Blocks.Set(_GetBlockLoc(x, z, level - 1), type);
+		}
+		else
+		{
+			m_Blocks.FillRun(_GetBlockLoc(x, z, height), level - height, type);
+			height = level;
+			m_MaxHeight = std::max(m_MaxHeight, height);
+		}
+
+		_MarkDirty(x, z);
+		return true;
+	}
+
+	bool Chunk::RemoveBlock(int x, int level, int z)
+	{
+		if (x < 0 || x >= m_XSize || z < 0 || z >= m_ZSize || level < 1)
+		{
+			return false;
+		}
+
+		int& height = m_BlockHeights[_GetLoc(x, z)];
+		if (level > height)
+		{
+			return false;
+		}
+
+		m_Blocks.FillRun(_GetBlockLoc(x, z, level - 1), height - level + 1, BlockType::NONE);
+		height = level - 1;
+		m_MinHeight = std::min(m_MinHeight, height);
+
+		_MarkDirty(x, z);
+		return true;
+	}
+
+	void Chunk::SetHaloHeight(int x, int z, int height)
+	{
+		const bool haloX = x == -1 || x == m_XSize;
+		const bool haloZ = z == -1 || z == m_ZSize;
+		PR_ASSERT(haloX != haloZ, "(Chunk) Not a halo column");
+
+		int& halo = m_BlockHeights[_GetLoc(x, z)];
+		if (halo == height)
+		{
+			return;
+		}
+
+		halo = height;
+		m_MinHeight = std::min(m_MinHeight, height);
+		// Only the column next to it exposes faces towards the halo
+		_MarkDirty(glm::clamp(x, 0, m_XSize - 1), glm::clamp(z, 0, m_ZSize - 1));
+	}
+
+	void Chunk::CopyHalo(const Chunk* const (&neighbours)[4])
+	{
+		// Halo column (x + i * dx, z + i * dz) is the neighbour's column (nx + i * dx, nz + i * dz)
+		struct Side { Face face; int x, z, nx, nz, dx, dz, count; };
+		const Side Sides[4] = {
+			{ Face::LEFT, m_XSize, 0, 0, 0, 0, 1, m_ZSize },
+			{ Face::RIGHT, -1, 0, m_XSize - 1, 0, 0, 1, m_ZSize },
+			{ Face::FRONT, 0, m_ZSize, 0, 0, 1, 0, m_XSize },
+			{ Face::BACK, 0, -1, 0, m_ZSize - 1, 1, 0, m_XSize },
+		};
+
+		bool copied = false;
+		for (auto& side : Sides)
+		{
+			const Chunk* neighbour = neighbours[static_cast<int>(side.face)];
+			if (!neighbour || (m_SkirtMask & (1 << static_cast<int>(side.face))))
+			{
+				continue;
+			}
+			PR_ASSERT(neighbour->m_XSize == m_XSize && neighbour->m_Lod == m_Lod, "(Chunk) Halo neighbour has another layout");
+
+			for (int i = 0; i < side.count; i++)
+			{
+				m_BlockHeights[_GetLoc(side.x + i * side.dx, side.z + i * side.dz)] =
+					neighbour->m_BlockHeights[_GetLoc(side.nx + i * side.dx, side.nz + i * side.dz)];
+			}
+			copied = true;
+		}
+
+		if (copied)
+		{
+			_FinishHeights();
+		}
+	}
+
+	void Chunk::GetBorder(Face side, std::vector<int>& out) const
+	{
+		const bool alongX = side == Face::FRONT || side == Face::BACK;
+		const int x = side == Face::LEFT ? m_XSize - 1 : 0;
+		const int z = side == Face::FRONT ? m_ZSize - 1 : 0;
+		const int count = alongX ? m_XSize : m_ZSize;
+
+		out.resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			out[i] = alongX ? m_BlockHeights[_GetLoc(i, z)] : m_BlockHeights[_GetLoc(x, i)];
+		}
+	}
+
+	void Chunk::SetHalo(Face side, const std::vector<int>& border)
+	{
+		if (m_SkirtMask & (1 << static_cast<int>(side)))
+		{
+			return;
+		}
+
+		const bool alongX = side == Face::FRONT || side == Face::BACK;
+		const int x = side == Face::LEFT ? m_XSize : -1;
+		const int z = side == Face::FRONT ? m_ZSize : -1;
+		PR_ASSERT(border.size() == static_cast<size_t>(alongX ? m_XSize : m_ZSize), "(Chunk) Halo border has another layout");
+
+		for (int i = 0; i < static_cast<int>(border.size()); i++)
+		{
+			if (alongX)
+			{
+				SetHaloHeight(i, z, border[i]);
+			}
+			else
+			{
+				SetHaloHeight(x, i, border[i]);
+			}
+		}
+	}
+
+	void Chunk::_MarkDirty(int x, int z)
+	{
+		// Neighbouring columns expose their side faces towards this one,
+		// so sections on the other side of a border get rebuilt too
+		static constexpr int Offsets[5][2] = { { 0, 0 }, { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+		for (auto& offset : Offsets)
+		{
+			int nx = x + offset[0];
+			int nz = z + offset[1];
+			if (nx < 0 || nx >= m_XSize || nz < 0 || nz >= m_ZSize || m_Sections.empty())
+			{
+				continue;
+			}
+
+			auto& section = m_Sections[(nz / SectionSize) * m_SectionsX + nx / SectionSize];
+			if (!section.dirty)
+			{
+				section.dirty = true;
+				m_DirtySections++;
+			}
+		}
+	}
+
+	void Chunk::RebuildMesh()
+	{
+		if (m_DirtySections == 0)
+		{
+			return;
+		}
+
+		// The float format has no per quad index free layout, remesh it whole
+		if (m_VertexFormat == VertexFormat::FLOAT)
+		{
+			GenerateMesh();
+			m_DataSentToGpu = false;
+			return;
+		}
+
+		// Rebuilt sections are appended past the end, then moved into their
+		// range if they still fit. Sections that don't fit keep their quads
+		// at the end and the whole mesh gets laid out again
+		const uint32_t meshEnd = m_PackedMesh->GetQuadCount();
+		std::vector<uint32_t> rebuiltFirst(m_Sections.size(), UINT32_MAX);
+		bool relayout = false;
+
+		for (size_t i = 0; i < m_Sections.size(); i++)
+		{
+			auto& section = m_Sections[i];
+			if (!section.dirty)
+			{
+				continue;
+			}
+
+			const int sx = static_cast<int>(i) % m_SectionsX;
+			const int sz = static_cast<int>(i) / m_SectionsX;
+			const uint32_t first = m_PackedMesh->GetQuadCount();
+			_GenerateSection(
+				sx * SectionSize, sz * SectionSize,
+				std::min((sx + 1) * SectionSize, m_XSize),
+				std::min((sz + 1) * SectionSize, m_ZSize)
+			);
+			const uint32_t count = m_PackedMesh->GetQuadCount() - first;
+
+			section.dirty = false;
+			rebuiltFirst[i] = first;
+			section.quadCount = count;
+			relayout |= count > section.capacity;
+		}
+		m_DirtySections = 0;
+
+		if (relayout)
+		{
+			_RelayoutSections(rebuiltFirst);
+			return;
+		}
+
+		for (size_t i = 0; i < m_Sections.size(); i++)
+		{
+			if (rebuiltFirst[i] == UINT32_MAX)
+			{
+				continue;
+			}
+
+			auto& section = m_Sections[i];
+			uint32_t* dst = m_PackedMesh->GetQuad(section.firstQuad);
+			std::copy_n(m_PackedMesh->GetQuad(rebuiltFirst[i]), section.quadCount * 4, dst);
+			std::fill_n(dst + section.quadCount * 4, (section.capacity - section.quadCount) * 4, 0u);
+
+			if (m_UploadFirst == m_UploadEnd)
+			{
+				m_UploadFirst = section.firstQuad;
+				m_UploadEnd = section.firstQuad + section.capacity;
+			}
+			else
+			{
+				m_UploadFirst = std::min(m_UploadFirst, section.firstQuad);
+				m_UploadEnd = std::max(m_UploadEnd, section.firstQuad + section.capacity);
+			}
+		}
+
+		m_PackedMesh->ResizeQuads(meshEnd);
+	}
+
+	void Chunk::_RelayoutSections(const std::vector<uint32_t>& rebuiltFirst)
+	{
+		// Every section gets room to grow by half so the next edits
+		// go back to the in place path
+		std::vector<uint32_t> data;
+		data.reserve(m_PackedMesh->GetVertexData().size() * 2);
+
+		for (size_t i = 0; i < m_Sections.size(); i++)
+		{
+			auto& section = m_Sections[i];
+			const uint32_t source = rebuiltFirst[i] != UINT32_MAX ? rebuiltFirst[i] : section.firstQuad;
+			const uint32_t* quads = m_PackedMesh->GetQuad(source);
+
+			section.firstQuad = static_cast<uint32_t>(data.size() / 4);
+			section.capacity = section.quadCount + section.quadCount / 2 + 4;
+			data.insert(data.end(), quads, quads + section.quadCount * 4);
+			data.resize((section.firstQuad + section.capacity) * 4, 0u);
+		}
+
+		m_PackedMesh->SetVertexData(std::move(data));
+		m_UploadFirst = m_UploadEnd = 0;
+		m_DataSentToGpu = false;
+	}
+
+	void Chunk::UpdateGpu()
+	{
+		// Never uploaded or laid out again, everything goes up
+		if (!m_DataSentToGpu)
+		{
+			SendToGpu();
+			m_UploadFirst = m_UploadEnd = 0;
+			return;
+		}
+
+		if (m_UploadFirst == m_UploadEnd)
+		{
+			return;
+		}
+
+		m_PackedMesh->FlushRange(m_UploadFirst, m_UploadEnd - m_UploadFirst);
+		m_UploadFirst = m_UploadEnd = 0;
+	}
+
+	Chunk::BlockType Chunk::_GetColumnMaterial(int x, int z) const
+	{
+		int height = m_BlockHeights[_GetLoc(x, z)];
+		if (height == 0)
+		{
+			// Empty columns still get a ground face
+			return BlockType::BLOCK;
+		}
+		return m_Blocks.Get(_GetBlockLoc(x, z, height - 1));
+	}
+
+	// Greedy rectangle merge over a w * h mask, 0 marks an empty cell.
+	// Cells are merged only with cells holding the same value and are
+	// consumed (zeroed) as they get emitted
+	template<typename F>
+	static void GreedyMerge(Utils::ScratchVector<int>& mask, int w, int h, F&& emit)
+	{
+		for (int v = 0; v < h; v++)
+		{
+			for (int u = 0; u < w;)
+			{
+				int value = mask[v * w + u];
+				if (value == 0)
+				{
+					u++;
+					continue;
+				}
+
+				int width = 1;
+				while (u + width < w && mask[v * w + u + width] == value)
+				{
+					width++;
+				}
+
+				int height = 1;
+				for (; v + height < h; height++)
+				{
+					int* row = &mask[(v + height) * w + u];
+					bool matches = true;
+					for (int k = 0; k < width; k++)
+					{
+						if (row[k] != value)
+						{
+							matches = false;
+							break;
+						}
+					}
+					if (!matches)
+					{
+						break;
+					}
+				}
+
+				for (int k = 0; k < height; k++)
+				{
+					std::fill_n(&mask[(v + k) * w + u], width, 0);
+				}
+
+				emit(u, v, width, height, value);
+				u += width;
+			}
+		}
+	}
+
+	void Chunk::_GenerateGreedyMesh(int x0, int z0, int x1, int z1)
+	{
+		const int width = x1 - x0;
+		const int depth = z1 - z0;
+
+		auto HeightAt = [&](int x, int z)
+		{
+			return m_BlockHeights[_GetLoc(x, z)];
+		};
+
+		// Sized for the side slices up front, growing would leave the old mask behind in the arena
+		Utils::ScratchScope scope;
+		Utils::ScratchVector<int> mask;
+		mask.reserve(std::max(width * depth, std::max(width, depth) * (m_YSize + 1)));
+
+		// Top faces, merged over columns with the same height and material
+		// Heights only go up to m_YSize so they fit under the material bits
+		mask.resize(width * depth);
+		for (int z = 0; z < depth; z++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				int material = static_cast<int>(_GetColumnMaterial(x0 + x, z0 + z));
+				mask[z * width + x] = (HeightAt(x0 + x, z0 + z) + 1) << 8 | material;
+			}
+		}
+
+		GreedyMerge(mask, width, depth, [&](int x, int z, int w, int d, int value)
+		{
+			x += x0;
+			z += z0;
+			int y = value >> 8;
+			auto material = static_cast<BlockType>(value & 0xff);
+
+			_CreateQuad(
+				Face::TOP, material,
+				x, y, z + d,
+				x, y, z,
+				x + w, y, z,
+				x + w, y, z + d
+			);
+		});
+
+		// Side faces, a column (x, z) exposes the levels (neighbour height, height]
+		// towards each of its four neighbours. Every slice is merged over
+		// (position along the slice, level)
+		const int levels = m_YSize + 1;
+		
+		// Left, Right walk slices along x, Front, Back along z
+		struct SideDir
+		{
+			Face face;
+			int dx, dz;
+			int planeOffset;
+		};
+		
+		static constexpr SideDir Sides[4] = {
+			{ Face::LEFT, 1, 0, 1 },
+			{ Face::RIGHT, -1, 0, 0 },
+			{ Face::FRONT, 0, 1, 1 },
+			{ Face::BACK, 0, -1, 0 },
+		};
+
+		for (const auto& side : Sides)
+		{
+			bool alongX = side.dx != 0;
+			int sliceStart = alongX ? x0 : z0;
+			int sliceEnd = alongX ? x1 : z1;
+			int uStart = alongX ? z0 : x0;
+			int sliceWidth = alongX ? depth : width;
+			mask.assign(sliceWidth * levels, 0);
+
+			for (int slice = sliceStart; slice < sliceEnd; slice++)
+			{
+				bool empty = true;
+				for (int u = 0; u < sliceWidth; u++)
+				{
+					int x = alongX ? slice : uStart + u;
+					int z = alongX ? uStart + u : slice;
+					int height = HeightAt(x, z);
+					int nh = HeightAt(x + side.dx, z + side.dz);
+					if (nh >= height)
+					{
+						continue;
+					}
+					
+					// Every level shows its own block, GreedyMerge only joins equal ones
+					for (int l = nh + 1; l <= height; l++)
+					{
+						mask[l * sliceWidth + u] = static_cast<int>(m_Blocks.Get(_GetBlockLoc(x, z, l - 1)));
+					}
+					empty = false;
+				}
+
+				if (empty)
+				{
+					continue;
+				}
+
+				int plane = slice + side.planeOffset;
+				GreedyMerge(mask, sliceWidth, levels, [&](int u, int l, int w, int h, int value)
+				{
+					auto material = static_cast<BlockType>(value);
+					u += uStart;
+
+					if (alongX)
+					{
+						_CreateQuad(
+							side.face, material,
+							plane, l + h, u,
+							plane, l, u,
+							plane, l, u + w,
+							plane, l + h, u + w
+						);
+					}
+					else
+					{
+						_CreateQuad(
+							side.face, material,
+							u, l + h, plane,
+							u, l, plane,
+							u + w, l, plane,
+							u + w, l + h, plane
+						);
+					}
+				});
+			}
+		}
+	}
+
+	void Chunk::_GeneratePerFaceMesh(int x0, int z0, int x1, int z1)
+	{
 		int yStart;
 		int yEnd;
 		int xStart;
@@ -252,16 +1065,17 @@ namespace Prism::Voxel
 			&xEnd, &yEnd, &zStart
 		};
 
-		for (int x = 0; x < m_XSize; x++)
+		for (int x = x0; x < x1; x++)
 		{
-			for (int z = 0; z < m_ZSize; z++)
+			for (int z = z0; z < z1; z++)
 			{
 				height = m_BlockHeights[_GetLoc(x, z)];
 
-				xStart = x * m_BlockSize;
-				xEnd = xStart + m_BlockSize;
-				zStart = z * m_BlockSize;
-				zEnd = zStart + m_BlockSize;
+				// Block units, scaled by the block size once the quad is emitted
+				xStart = x;
+				xEnd = x + 1;
+				zStart = z;
+				zEnd = z + 1;
 				
 				int positions[12] = {
 					x + 1, z, -1, // Left
@@ -272,16 +1086,8 @@ namespace Prism::Voxel
 
 				for (int i = 0; i < 4; i++)
 				{
-					int nh;
 					int* PosPtr = &positions[i * 3];
-					if (_Check2DBounds(PosPtr[0], PosPtr[1]))
-					{
-						nh = m_BlockHeights[_GetLoc(PosPtr[0], PosPtr[1])];
-					}
-					else
-					{
-						nh = _FetchNeighbour(PosPtr[0], PosPtr[1]);						
-					}
+					int nh = m_BlockHeights[_GetLoc(PosPtr[0], PosPtr[1])];
 					if (nh >= height)
 					{
 						goto LOOPEXIT;
@@ -292,20 +1098,18 @@ namespace Prism::Voxel
 					PossibleSides[i] = -1;
 				}
 				
-				yStart = height * m_BlockSize;
-				yEnd = yStart + m_BlockSize;
+				yStart = height;
+				yEnd = height + 1;
 
-				float r = 0.f;
-				float g = 0.8f;
-				float b = 0.1f;
+				BlockType material = _GetColumnMaterial(x, z);
 
 				_CreateQuad(
+					Face::TOP, material,
 					xStart, yEnd, zEnd,
 					xStart, yEnd, zStart,
 					xEnd, yEnd, zStart,
 					xEnd, yEnd, zEnd
 				);
-				_PassVertParam(m_ColorBuffer, { r, g, b });
 
 				for (int i = 0; i < 4; i++)
 				{
@@ -314,24 +1118,22 @@ namespace Prism::Voxel
 						int fl = height + 1;
 						while (fl-- > PossibleSides[i] + 1)
 						{
-							yStart = fl * m_BlockSize;
-							yEnd = yStart + m_BlockSize;
+							yStart = fl;
+							yEnd = fl + 1;
 							int* Positions = &positions[i * 3];
 							int** Vertex = &VertexOffsets[i * 12];
 							float* Normal = &Normals[i * 3];
 							_CreateQuad(
+								static_cast<Face>(i), m_Blocks.Get(_GetBlockLoc(x, z, fl - 1)),
 								*Vertex[0], *Vertex[1], *Vertex[2],
 								*Vertex[3], *Vertex[4], *Vertex[5],
 								*Vertex[6], *Vertex[7], *Vertex[8],
 								*Vertex[9], *Vertex[10], *Vertex[11]
 							);
-							_PassVertParam(m_ColorBuffer, { r, g, b });
 						}
 					}
 				}
 			}
 		}
-
-		*m_MeshReady = true;
 	}
 }
@@ -3,8 +3,13 @@
 #include <vector>
 
 #include "prism/Renderer/DynamicMesh.h"
+#include "prism/Renderer/PackedQuadMesh.h"
 #include "prism/Core/SharedContext.h"
 #include "prism/Renderer/AllocatedMesh.h"
+#include "HeightSource.h"
+#include "PalettedContainer.h"
+#include "prism/System/ScopeTimer.h"
+#include "prism/Utils/ScratchArena.h"
 
 namespace Prism::Voxel
 {
@@ -17,7 +22,30 @@ namespace Prism::Voxel
 		{
 			return (x == other.x) && (y == other.y);
 		}
+
+		bool operator!=(const Prism::Voxel::Vec2& other) const noexcept
+		{
+			return !(*this == other);
+		}
+	};
+}
+
+namespace std
+{
+	template<> struct hash<Prism::Voxel::Vec2>
+	{
+		size_t operator()(const Prism::Voxel::Vec2& vec) const noexcept
+		{
+			hash<int> hasher;
+			auto a = hasher(vec.x);
+			auto b = hasher(vec.y);
+			return b + 0x9e3779b9 + (a << 6) + (a >> 2);
+		}
 	};
+}
+
+namespace Prism::Voxel
+{
 
 	
 	class Chunk
@@ -28,13 +56,9 @@ namespace Prism::Voxel
 		{
 			NONE = 0,
 			BLOCK,// TEMP
-			DIRT
-		};
+			DIRT,
 
-		struct BlockData
-		{
-			BlockType Type{ BlockType::NONE };
-			Vec2 Pos;
+			COUNT
 		};
 
 		enum class ChunkBlockPosition
@@ -45,19 +69,117 @@ namespace Prism::Voxel
 			COUNT
 		};
 
-		Chunk(int Size, int blockSize);
+		// PERFACE emits a quad for every exposed block face,
+		// GREEDY merges coplanar faces of the same material into larger quads
+		enum class MeshingMode
+		{
+			PERFACE = 0,
+			GREEDY
+		};
+
+		// FLOAT uses float3 position, normal and color streams (36 bytes per vertex),
+		// PACKED stores a vertex in one 32 bit word decoded in voxel.vert:
+		// x(7) y(7) z(7) in blocks, face(3), material(8)
+		enum class VertexFormat
+		{
+			FLOAT = 0,
+			PACKED
+		};
+
+		// Order matches the neighbour order used while meshing
+		enum class Face
+		{
+			LEFT = 0,	// +x
+			RIGHT,		// -x
+			FRONT,		// +z
+			BACK,		// -z
+			TOP
+		};
+
+		// Side faces come in pairs, the neighbour on one side sees this chunk on the other
+		static Face Opposite(Face face)
+		{
+			return static_cast<Face>(static_cast<int>(face) ^ 1);
+		}
+
+		static constexpr int PackedMaxSize = 127;
+		// Coarsest level keeps at least this many columns per side
+		static constexpr int MinLodSize = 4;
+		// Meshes are built out of SectionSize * SectionSize column sections,
+		// each one owning a contiguous range of the mesh so it can be rebuilt alone
+		static constexpr int SectionSize = 16;
+
+		Chunk(int Size, int blockSize, VertexFormat format = VertexFormat::FLOAT);
 		
 		void Allocate();
+		// Samples the columns and the halo ring from the height source in one region
 		void Populate();
-		void SetPopulationFunction(std::function<float(int, int)> PopFunc);
+		// Same as Populate with a source the caller knows the type of, a final
+		// source class gets its FillRegion call resolved at compile time
+		template<typename Source>
+		void Populate(const Source& source)
+		{
+			System::Time::Scope<System::Time::Miliseconds> RandomTimer("Chunk Population");
+			Utils::ScratchScope scope;
+			Utils::ScratchVector<float> samples(m_BlockHeights.size());
+			source.FillRegion(_HaloRegion(), samples.data());
+			_PopulateFromSamples(samples.data());
+		}
+		// Kept for the halo of chunks loaded from disk and used by Populate()
+		void SetHeightSource(Ref<const IHeightSource> source);
 		void SetMappingFunction(std::function<void()> MapFunc);
+		void SetMeshingMode(MeshingMode mode);
 		void GenerateMesh();
 		void SendToGpu();
+		// Uploads a batch of freshly meshed chunks, the shared index buffer is grown once for all of them
+		static void SendToGpu(const std::vector<Chunk*>& chunks);
 		void SetOffset(int x, int y);
+		// Every level halves the columns per side and doubles the block size,
+		// the chunk keeps covering the same area. Takes effect on the next Allocate
+		void SetLod(int lod);
+		// Bit (1 << Face) drops the halo on that side to the bottom so side
+		// faces reach down and cover cracks next to a chunk with another lod
+		void SetSkirtMask(uint8_t mask);
+		// Columns stay solid from the bottom up, a column of height h shows the
+		// levels 0 up to h and level l > 0 has the material of block l - 1.
+		// Placing above the surface fills the column up to the level, removing
+		// a level removes everything above it. Level 0 can't be removed.
+		// Returns false when nothing changed
+		bool SetBlock(int x, int level, int z, BlockType type);
+		bool RemoveBlock(int x, int level, int z);
+		// Compact encoding of the heights and blocks, see Chunk.cpp for the layout
+		void Serialize(std::vector<uint8_t>& out) const;
+		// Takes the place of Populate, the chunk has to be allocated with the
+		// same lod it was saved with. Returns false on a corrupt payload
+		bool Deserialize(const uint8_t* data, size_t size);
+
+		// Updates a halo column after a neighbour chunk edited its border
+		void SetHaloHeight(int x, int z, int height);
+		// Replaces the sampled halo with the border columns of populated
+		// neighbours at the same lod, indexed by Face. nullptr and skirted
+		// sides are left alone. Has to run before GenerateMesh
+		void CopyHalo(const Chunk* const (&neighbours)[4]);
+		// Columns along the side of the chunk facing side, what the neighbour
+		// there needs as its halo on Opposite(side)
+		void GetBorder(Face side, std::vector<int>& out) const;
+		// Writes a neighbour's border into the halo through SetHaloHeight,
+		// a skirted side is left alone
+		void SetHalo(Face side, const std::vector<int>& border);
+		int GetHeight(int x, int z) const
+		{
+			return m_BlockHeights[_GetLoc(x, z)];
+		}
+
+		bool HasDirtySections() const
+		{
+			return m_DirtySections > 0;
+		}
+
+		// Remeshes only the sections touched by edits since the last rebuild
 		void RebuildMesh();
 		void UpdateGpu(); // Will update only if rebuild has been called
 		
-		const Vec2& GetOffset()
+		Vec2 GetOffset() const
 		{
 			return Vec2{ m_XOffset, m_YOffset };
 		}
@@ -72,7 +194,7 @@ namespace Prism::Voxel
 			return m_Position;
 		}
 		
-		const glm::vec3& Size()
+		glm::vec3 Size() const
 		{
 			return glm::vec3{
 				m_XSize * m_BlockSize,
@@ -81,49 +203,179 @@ namespace Prism::Voxel
 			};
 		}
 
-		bool MeshReady()
+		// Set by GenerateMesh, readers synchronise with the job that meshed it
+		bool MeshReady() const
+		{
+			return m_MeshReady;
+		}
+
+		MeshingMode GetMeshingMode() const
+		{
+			return m_MeshingMode;
+		}
+
+		VertexFormat GetVertexFormat() const
+		{
+			return m_VertexFormat;
+		}
+
+		int GetBlockSize() const
 		{
-			return *m_MeshReady;
+			return m_BlockSize;
+		}
+
+		int GetLod() const
+		{
+			return m_Lod;
+		}
+
+		// Highest column including the halo ring, in the chunk's own levels
+		int GetMaxHeight() const
+		{
+			return m_MaxHeight;
+		}
+
+		uint8_t GetSkirtMask() const
+		{
+			return m_SkirtMask;
+		}
+
+		// World space bounds of the mesh, the y extent comes from the
+		// lowest and highest column including the halo ring. A column of
+		// height h has its top face at level h + 1
+		glm::vec3 GetBoundsMin() const
+		{
+			return m_Position + glm::vec3{ 0.f, m_MinHeight * m_BlockSize, 0.f };
+		}
+
+		glm::vec3 GetBoundsMax() const
+		{
+			return m_Position + glm::vec3{
+				m_XSize * m_BlockSize,
+				(m_MaxHeight + 1) * m_BlockSize,
+				m_ZSize * m_BlockSize
+			};
+		}
+
+		// Highest lod that still keeps MinLodSize columns
+		static int MaxLod(int Size)
+		{
+			int lod = 0;
+			while ((Size >> (lod + 1)) >= MinLodSize)
+			{
+				lod++;
+			}
+			return lod;
+		}
+
+		uint32_t GetVertexCount() const
+		{
+			if (m_VertexFormat == VertexFormat::PACKED)
+			{
+				return m_PackedMesh->GetVertexCount();
+			}
+			return m_Mesh->GetVertexCount();
+		}
+
+		uint32_t GetIndexCount() const
+		{
+			if (m_VertexFormat == VertexFormat::PACKED)
+			{
+				return m_PackedMesh->GetElementCount();
+			}
+			return m_Mesh->GetElementCount();
+		}
+
+		// Bytes uploaded for the vertex and index streams
+		size_t GetMeshMemorySize() const;
+
+		// Bytes the block data takes on the cpu
+		size_t GetBlockMemorySize() const
+		{
+			return m_Blocks.MemorySize() + m_BlockHeights.size() * sizeof(int);
 		}
 
 		// Will prepare for destruction
 		void Clear();
 		void PrepareForClearing();
+		// Prepares the chunk to be populated again, usually at another offset
+		void Recycle();
 		void Render();
 	private:
+		struct Section
+		{
+			uint32_t firstQuad{ 0 };
+			uint32_t quadCount{ 0 };
+			// Quads reserved for the section, the rest are degenerate padding
+			uint32_t capacity{ 0 };
+			bool dirty{ false };
+		};
+
+		// Meshes columns [x0, x1) * [z0, z1)
+		void _GenerateSection(int x0, int z0, int x1, int z1);
+		void _GeneratePerFaceMesh(int x0, int z0, int x1, int z1);
+		void _GenerateGreedyMesh(int x0, int z0, int x1, int z1);
+		uint32_t _GetQuadCount() const;
+		void _MarkDirty(int x, int z);
+		void _RelayoutSections(const std::vector<uint32_t>& rebuiltFirst);
+		// Bit (1 << Face) samples that side of the halo ring
+		void _SampleHalo(uint8_t sides);
+		// Applies the skirts and computes the height bounds
+		void _FinishHeights();
+		BlockType _GetColumnMaterial(int x, int z) const;
+		// Corners are in blocks, relative to the chunk
 		void _CreateQuad(
+			Face face, BlockType material,
 			int v0x, int v0y, int v0z,
 			int v1x, int v1y, int v1z,
 			int v2x, int v2y, int v2z,
-			int v4x, int v3y, int v3z
+			int v3x, int v3y, int v3z
 		);
+		static glm::vec3 _GetMaterialColor(BlockType material);
+
+		static uint32_t _PackVertex(int x, int y, int z, Face face, BlockType material)
+		{
+			return static_cast<uint32_t>(x)
+				| static_cast<uint32_t>(y) << 7
+				| static_cast<uint32_t>(z) << 14
+				| static_cast<uint32_t>(face) << 21
+				| static_cast<uint32_t>(material) << 24;
+		}
 		void _PassBlockParam(const glm::vec3& param);
 		void _PassVertParam(uint32_t buffer, const glm::vec3& param);
 
+		// Heights carry a one column halo ring around the chunk,
+		// x and y go from -1 up to and including the chunk size
 		int _GetLoc(int x, int y) const
 		{
-			return m_XSize * y + x;
+			return (m_XSize + 2) * (y + 1) + x + 1;
 		}
 		
-		int _GetBlockLoc(int x, int y, int z) const
+		// Columns are contiguous so a whole column can be filled as one run
+		int _GetBlockLoc(int x, int z, int level) const
 		{
-			return m_XSize * (y + m_ZSize * z) + x;
+			return (x * m_ZSize + z) * m_YSize + level;
 		}
 
-		bool _Check2DBounds(int x, int y)
+		// Converts a population value into a column height at the current lod,
+		// rounded up to the lod's block size
+		int _ToHeight(float sample) const
 		{
-			// return !(x < 0 && x > m_XSize && y < 0 &&  y > m_ZSize);
-			return x > 0 && x < m_XSize && y > 0 && y < m_ZSize;
+			const int step = 1 << m_Lod;
+			int ySize = m_Size - 1;
+			int height = ceil(sample * ySize);
+			height = (height + step - 1) >> m_Lod;
+			return glm::clamp(height, 0, m_YSize);
 		}
 
-		int _FetchNeighbour(int x, int y)
+		// Interior columns plus the halo ring, laid out like m_BlockHeights
+		HeightRegion _HaloRegion() const
 		{
-			int xOffset = x + m_XSize * m_XOffset;
-			int zOffset = y + m_ZSize * m_YOffset;
-			int ySize = m_YSize - 1;
-			int height = ceil(m_PopulationFunction(xOffset, zOffset) * ySize);
-			return glm::clamp(height, 0, m_YSize);
+			const int step = 1 << m_Lod;
+			return { m_Size * m_XOffset - step, m_Size * m_YOffset - step, m_XSize + 2, m_ZSize + 2, step };
 		}
+
+		void _PopulateFromSamples(const float* samples);
 		
 		ChunkBlockPosition _GetBlockState(int x, int y, int z)
 		{
@@ -137,7 +389,7 @@ namespace Prism::Voxel
 				ChunkBlockPosition::BODY,
 			};
 			
-			return ChunkBlockSelection[(int)m_Blocks[_GetBlockLoc(x, y, z)].Type];
+			return ChunkBlockSelection[(int)m_Blocks.Get(_GetBlockLoc(x, z, y))];
 		}
 
 		bool _BodyBlockExists(ChunkBlockPosition b)
@@ -146,22 +398,41 @@ namespace Prism::Voxel
 		}
 
 		Ptr<MeshType> m_Mesh;
+		Ptr<Renderer::PackedQuadMesh> m_PackedMesh;
 		//Ptr<Renderer::DynamicMesh> m_Mesh;
-		std::vector<BlockData> m_Blocks; // Vector of vectors to secure infinite height on terrain
+		PalettedContainer<BlockType> m_Blocks;
 		 // Will be used once the mesh is created to create a more
 		//  optimized mesh for adding and removing blocks
-		std::vector<int> m_BlockHeights;
+		std::vector<int> m_BlockHeights; // (x + 2) * (z + 2), includes the halo ring
 		std::function<void()> m_MappingFunction;
-		std::function<float(int, int)> m_PopulationFunction;
+		Ref<const IHeightSource> m_HeightSource;
 		uint32_t m_NormalBuffer;
 		uint32_t m_ColorBuffer;
-		Ptr<std::atomic_bool> m_MeshReady;
+		bool m_MeshReady{ false };
 		glm::vec3 m_Position;
 		glm::mat4 m_Transform{ 1.f };
+		MeshingMode m_MeshingMode{ MeshingMode::PERFACE };
+		VertexFormat m_VertexFormat;
 		int m_CreatedFaces{ 0 };
 		bool m_IsAllocated{ false };
 		bool m_DataSentToGpu{ false };
 
+		// Size and block size at lod 0
+		int m_Size;
+		int m_BaseBlockSize;
+		int m_Lod{ 0 };
+		int m_MinHeight{ 0 };
+		int m_MaxHeight{ 0 };
+
+		std::vector<Section> m_Sections;
+		int m_SectionsX{ 0 };
+		int m_SectionsZ{ 0 };
+		int m_DirtySections{ 0 };
+		// Quads changed in place since the last upload, [first, end)
+		uint32_t m_UploadFirst{ 0 };
+		uint32_t m_UploadEnd{ 0 };
+		uint8_t m_SkirtMask{ 0 };
+
 		int m_BlockSize;
 		int m_XSize;
 		int m_YSize;
@@ -0,0 +1,1037 @@
+#include "ChunkStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <thread>
+
+#include "prism/System/Log.h"
+#include "prism/System/ParallelFor.h"
+#include "prism/System/TaskGraph.h"
+#include "prism/System/Time.h"
+
+namespace Prism::Voxel
+{
+	// Neighbour offsets in the same order as Chunk::Face
+	static constexpr int FaceDirections[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+	struct ChunkStreamer::Batch
+	{
+		struct Job
+		{
+			Chunk* chunk{ nullptr };
+			Vec2 coord{ 0, 0 };
+			uint64_t ticket{ 0 };
+			System::CancellationToken token;
+			Ref<RegionStore> store;
+			int priority{ 0 };
+			// Set by the populate stage, neighbours read it once they left it
+			bool populated{ false };
+			// Batch jobs at the same lod, indexed by Chunk::Face
+			int neighbours[4]{ -1, -1, -1, -1 };
+			// Border columns of meshed neighbours outside the batch, indexed by Chunk::Face.
+			// Copied on the main thread, the neighbour can be edited while the job runs
+			std::vector<int> borders[4];
+			// Meshing waits for the neighbours to populate, the chunk is only
+			// handed back once the neighbours meshing against it are done.
+			// Every stage is left, cancelled or not
+			System::TaskGraph::Node populate{ 0 };
+			System::TaskGraph::Node mesh{ 0 };
+			System::TaskGraph::Node done{ 0 };
+		};
+
+		std::vector<Job> jobs;
+		Ref<System::TaskGraph> graph;
+		Ref<CompletionQueue> completed;
+		Ref<HeightCache> cache;
+		NoiseParams params;
+		Ref<const IHeightSource> source;
+		int size{ 0 };
+	};
+
+	ChunkStreamer::ChunkStreamer(Ref<System::ThreadPool> worker)
+		:
+		m_Worker(std::move(worker)),
+		m_Completed(MakeRef<CompletionQueue>(m_Settings.MaxJobsInFlight))
+	{
+		_BuildLoadOffsets();
+	}
+
+	ChunkStreamer::~ChunkStreamer()
+	{
+		// Jobs hold raw pointers to the chunks
+		WaitForJobs();
+		SetStore(nullptr);
+	}
+
+	void ChunkStreamer::Configure(const Settings& settings)
+	{
+		Settings next = settings;
+		next.LoadRadius = std::max(next.LoadRadius, 0);
+		next.UnloadRadius = std::max(next.UnloadRadius, next.LoadRadius);
+		next.MaxJobsInFlight = std::max(next.MaxJobsInFlight, 1);
+		next.MaxNewJobsPerUpdate = std::max(next.MaxNewJobsPerUpdate, 1);
+		next.LodDistance = std::max(next.LodDistance, 0);
+		next.MaxLod = std::clamp(next.MaxLod, 0, 3);
+
+		const bool layoutChanged =
+			next.ChunkSize != m_Settings.ChunkSize ||
+			next.BlockSize != m_Settings.BlockSize ||
+			next.Format != m_Settings.Format;
+		const bool radiusChanged =
+			next.LoadRadius != m_Settings.LoadRadius ||
+			next.UnloadRadius != m_Settings.UnloadRadius;
+		const bool meshingChanged = next.Meshing != m_Settings.Meshing;
+
+		m_Settings = next;
+
+		// Jobs already queued push to the queue they were given
+		if (static_cast<size_t>(m_Settings.MaxJobsInFlight) > m_Completed->Capacity())
+		{
+			WaitForJobs();
+			m_Completed = MakeRef<CompletionQueue>(m_Settings.MaxJobsInFlight);
+		}
+
+		if (layoutChanged)
+		{
+			WaitForJobs();
+			_DropAll();
+		}
+		else if (meshingChanged)
+		{
+			Regenerate();
+		}
+
+		if (radiusChanged)
+		{
+			_BuildLoadOffsets();
+		}
+
+		// Radii, lod rings and the job budget are read by the scans
+		m_UnloadPending = true;
+		_RestartQueue();
+	}
+
+	void ChunkStreamer::SetHeightSource(Ref<const IHeightSource> source)
+	{
+		m_HeightSource = std::move(source);
+	}
+
+	void ChunkStreamer::SetHeightCache(Ref<HeightCache> cache, const NoiseParams& params)
+	{
+		m_HeightCache = std::move(cache);
+		m_NoiseParams = params;
+	}
+
+	void ChunkStreamer::SetStore(Ref<RegionStore> store)
+	{
+		for (auto& [coord, slot] : m_Loaded)
+		{
+			_SaveModified(coord, slot);
+		}
+		m_Store = std::move(store);
+	}
+
+	void ChunkStreamer::Regenerate()
+	{
+		m_Epoch++;
+		_RestartQueue();
+		for (auto& [coord, slot] : m_Loaded)
+		{
+			if (slot.job.IsValid())
+			{
+				_CancelJob(slot);
+			}
+		}
+	}
+
+	void ChunkStreamer::Update(const glm::vec3& position)
+	{
+		const Vec2 center = _WorldToChunk(position);
+		if (center != m_Center)
+		{
+			m_Center = center;
+			m_UnloadPending = true;
+			_RestartQueue();
+		}
+
+		// Halos the finished jobs changed are rebuilt along with the edits,
+		// every edited chunk is still loaded and nothing recycled it yet
+		_DrainCompleted();
+		_RebuildEdited();
+		_ReleaseRetired();
+		// Both scans walk every loaded chunk or load offset, they only
+		// run when the center, the settings or the job budget changed
+		if (m_UnloadPending)
+		{
+			_UnloadFar();
+		}
+		_TrimPool();
+		if (m_QueuePending)
+		{
+			_QueueMissing();
+		}
+		_UpdateStats();
+	}
+
+	void ChunkStreamer::ForEachReady(const std::function<void(Chunk&)>& func)
+	{
+		for (auto* slot : m_Drawable)
+		{
+			func(*slot->chunk);
+		}
+	}
+
+	void ChunkStreamer::ForEachVisible(const Renderer::Frustum& frustum, const std::function<void(Chunk&)>& func)
+	{
+		m_Culler.Clear();
+		m_CullList.clear();
+		m_Culler.Reserve(m_Drawable.size());
+
+		for (auto* slot : m_Drawable)
+		{
+			m_Culler.AddBox(slot->chunk->GetBoundsMin(), slot->chunk->GetBoundsMax());
+			m_CullList.push_back(slot->chunk.get());
+		}
+
+		const size_t visible = m_Culler.Cull(frustum);
+		m_Stats.Drawn = static_cast<int>(visible);
+		m_Stats.Culled = static_cast<int>(m_CullList.size() - visible);
+
+		for (size_t i = 0; i < m_CullList.size(); i++)
+		{
+			if (!m_Culler.IsVisible(i))
+			{
+				continue;
+			}
+
+			func(*m_CullList[i]);
+		}
+	}
+
+	void ChunkStreamer::WaitForJobs()
+	{
+		auto wait = [this](const Slot& slot)
+		{
+			while (_JobRunning(slot))
+			{
+				std::this_thread::yield();
+			}
+		};
+
+		for (auto& slot : m_Retiring)
+		{
+			wait(slot);
+		}
+		for (auto& [coord, slot] : m_Loaded)
+		{
+			wait(slot);
+		}
+
+		// Every job pushed its completion before it returned
+		_DrainCompleted();
+		_ReleaseRetired();
+		PR_ASSERT(m_InFlight == 0, "(ChunkStreamer) Jobs left after waiting");
+	}
+
+	bool ChunkStreamer::SetBlock(int x, int level, int z, Chunk::BlockType type)
+	{
+		const int size = m_Settings.ChunkSize;
+		const Vec2 coord{
+			static_cast<int>(std::floor(x / static_cast<float>(size))),
+			static_cast<int>(std::floor(z / static_cast<float>(size)))
+		};
+		const int lx = x - coord.x * size;
+		const int lz = z - coord.y * size;
+
+		Slot* slot = _EditableSlot(coord);
+		if (!slot || !slot->chunk->SetBlock(lx, level, lz, type))
+		{
+			return false;
+		}
+		_MarkEdited(*slot);
+
+		// Border columns are in the halo of the chunk next to them
+		struct Neighbour { bool border; int dx, dz; int hx, hz; Chunk::Face face; };
+		const Neighbour Neighbours[4] = {
+			{ lx == 0, -1, 0, size, lz, Chunk::Face::LEFT },
+			{ lx == size - 1, 1, 0, -1, lz, Chunk::Face::RIGHT },
+			{ lz == 0, 0, -1, lx, size, Chunk::Face::FRONT },
+			{ lz == size - 1, 0, 1, lx, -1, Chunk::Face::BACK },
+		};
+
+		const int height = slot->chunk->GetHeight(lx, lz);
+		for (auto& n : Neighbours)
+		{
+			Slot* neighbour = n.border ? _EditableSlot({ coord.x + n.dx, coord.y + n.dz }) : nullptr;
+			// Skirted sides keep their halo at the bottom
+			if (!neighbour || (neighbour->chunk->GetSkirtMask() & (1 << static_cast<int>(n.face))))
+			{
+				continue;
+			}
+
+			neighbour->chunk->SetHaloHeight(n.hx, n.hz, height);
+			_MarkEdited(*neighbour);
+		}
+
+		return true;
+	}
+
+	int ChunkStreamer::GetSurfaceLevel(int x, int z)
+	{
+		const int size = m_Settings.ChunkSize;
+		const Vec2 coord{
+			static_cast<int>(std::floor(x / static_cast<float>(size))),
+			static_cast<int>(std::floor(z / static_cast<float>(size)))
+		};
+
+		Slot* slot = _EditableSlot(coord);
+		if (!slot)
+		{
+			return -1;
+		}
+		return slot->chunk->GetHeight(x - coord.x * size, z - coord.y * size);
+	}
+
+	const Chunk* ChunkStreamer::FindReadyChunk(const Vec2& coord) const
+	{
+		auto itr = m_Loaded.find(coord);
+		if (itr == m_Loaded.end() || itr->second.job.IsValid() || !itr->second.chunk || !itr->second.chunk->MeshReady())
+		{
+			return nullptr;
+		}
+		return itr->second.chunk.get();
+	}
+
+	Raycaster ChunkStreamer::GetRaycaster() const
+	{
+		return Raycaster(m_Settings.ChunkSize, m_Settings.BlockSize, [this](const Vec2& coord)
+			{
+				return FindReadyChunk(coord);
+			});
+	}
+
+	ChunkStreamer::Slot* ChunkStreamer::_EditableSlot(const Vec2& coord)
+	{
+		auto itr = m_Loaded.find(coord);
+		if (itr == m_Loaded.end())
+		{
+			return nullptr;
+		}
+
+		Slot& slot = itr->second;
+		if (slot.job.IsValid() || !slot.chunk || slot.chunk->GetLod() != 0 || !slot.chunk->MeshReady())
+		{
+			return nullptr;
+		}
+		return &slot;
+	}
+
+	void ChunkStreamer::_MarkEdited(Slot& slot)
+	{
+		slot.modified = true;
+		_QueueRebuild(slot);
+	}
+
+	void ChunkStreamer::_QueueRebuild(Slot& slot)
+	{
+		if (std::find(m_Edited.begin(), m_Edited.end(), &slot) == m_Edited.end())
+		{
+			m_Edited.push_back(&slot);
+		}
+	}
+
+	void ChunkStreamer::_SaveModified(const Vec2& coord, Slot& slot)
+	{
+		if (!slot.modified || !m_Store)
+		{
+			return;
+		}
+
+		// Edits only happen on idle chunks, so the blocks are safe to read here
+		std::vector<uint8_t> payload;
+		slot.chunk->Serialize(payload);
+		m_Store->Save(coord, std::move(payload));
+		slot.modified = false;
+	}
+
+	void ChunkStreamer::_RebuildEdited()
+	{
+		if (m_Edited.empty())
+		{
+			return;
+		}
+
+		auto start = System::Time::Clock::now();
+		// An edit on a border touches up to three chunks, they remesh in parallel and upload here
+		System::ParallelFor(*m_Worker, 0, m_Edited.size(), 1, [this](size_t first, size_t last)
+			{
+				for (size_t i = first; i < last; i++)
+				{
+					m_Edited[i]->chunk->RebuildMesh();
+				}
+			});
+		for (auto* slot : m_Edited)
+		{
+			slot->chunk->UpdateGpu();
+			// The mesh size changed
+			if (slot->drawIndex >= 0)
+			{
+				_AddDrawable(*slot);
+			}
+		}
+
+		m_Stats.EditNanoseconds = System::Time::DurationCast<System::Time::Nanoseconds>(System::Time::Clock::now() - start);
+		m_Stats.EditedChunks = static_cast<int>(m_Edited.size());
+		m_Edited.clear();
+	}
+
+	Vec2 ChunkStreamer::_WorldToChunk(const glm::vec3& position) const
+	{
+		const float extent = static_cast<float>(m_Settings.ChunkSize * m_Settings.BlockSize);
+		return Vec2{
+			static_cast<int>(std::floor(position.x / extent)),
+			static_cast<int>(std::floor(position.z / extent))
+		};
+	}
+
+	bool ChunkStreamer::_JobRunning(const Slot& slot) const
+	{
+		return slot.job.IsValid() && !slot.job.IsDone();
+	}
+
+	void ChunkStreamer::_CancelJob(Slot& slot)
+	{
+		slot.token.Cancel();
+		slot.epoch = 0;
+	}
+
+	bool ChunkStreamer::_CollectJob(Slot& slot)
+	{
+		// Left empty even if the job threw
+		System::Task<void> job = std::move(slot.job);
+		m_InFlight--;
+		// A cancelled job leaves its slot stale, closer offsets may need it again
+		if (slot.epoch != m_Epoch)
+		{
+			_RestartQueue();
+		}
+		m_QueuePending = true;
+		const Vec2 coord = slot.building->GetOffset();
+		try
+		{
+			job.Get();
+			return true;
+		}
+		catch (const std::exception& e)
+		{
+			PR_CORE_ERROR("(ChunkStreamer) Job for chunk {0}, {1} failed: {2}", coord.x, coord.y, e.what());
+		}
+		catch (...)
+		{
+			PR_CORE_ERROR("(ChunkStreamer) Job for chunk {0}, {1} failed", coord.x, coord.y);
+		}
+
+		// Stale, queued again the next time it's needed
+		slot.epoch = 0;
+		_RestartQueue();
+		return false;
+	}
+
+	void ChunkStreamer::_FinishJob(const Vec2& coord, Slot& slot)
+	{
+		// The old chunk was drawn up to here, a failed or cancelled job keeps it
+		if (_CollectJob(slot) && slot.building->MeshReady())
+		{
+			std::swap(slot.chunk, slot.building);
+			m_Uploads.push_back(slot.chunk.get());
+			_AddDrawable(slot);
+			_SyncHalos(coord, slot);
+		}
+		_RecycleChunk(std::move(slot.building));
+	}
+
+	void ChunkStreamer::_SyncHalos(const Vec2& coord, Slot& slot)
+	{
+		// A neighbour that finished while this job ran couldn't hand over its border,
+		// both sides may have meshed against sampled heights that are off where the
+		// other one has edits or heights loaded from the store. Only changed columns get dirty
+		Chunk* chunk = slot.chunk.get();
+		for (int face = 0; face < 4; face++)
+		{
+			auto itr = m_Loaded.find({ coord.x + FaceDirections[face][0], coord.y + FaceDirections[face][1] });
+			if (itr == m_Loaded.end())
+			{
+				continue;
+			}
+
+			Slot& neighbour = itr->second;
+			if (neighbour.job.IsValid() || !neighbour.chunk || !neighbour.chunk->MeshReady() ||
+				neighbour.chunk->GetLod() != chunk->GetLod())
+			{
+				continue;
+			}
+
+			const auto side = static_cast<Chunk::Face>(face);
+			chunk->GetBorder(side, m_Border);
+			neighbour.chunk->SetHalo(Chunk::Opposite(side), m_Border);
+			neighbour.chunk->GetBorder(Chunk::Opposite(side), m_Border);
+			chunk->SetHalo(side, m_Border);
+
+			if (neighbour.chunk->HasDirtySections())
+			{
+				_QueueRebuild(neighbour);
+			}
+		}
+
+		if (chunk->HasDirtySections())
+		{
+			_QueueRebuild(slot);
+		}
+	}
+
+	void ChunkStreamer::_AddDrawable(Slot& slot)
+	{
+		if (slot.drawIndex >= 0)
+		{
+			_CountDrawable(slot, false);
+		}
+		else
+		{
+			slot.drawIndex = static_cast<int>(m_Drawable.size());
+			m_Drawable.push_back(&slot);
+		}
+
+		slot.counted.blockMemory = slot.chunk->GetBlockMemorySize();
+		slot.counted.meshMemory = slot.chunk->GetMeshMemorySize();
+		slot.counted.vertices = slot.chunk->GetVertexCount();
+		slot.counted.lod = std::min(slot.chunk->GetLod(), 3);
+		_CountDrawable(slot, true);
+	}
+
+	void ChunkStreamer::_CountDrawable(const Slot& slot, bool add)
+	{
+		const auto& counted = slot.counted;
+		if (add)
+		{
+			m_Stats.BlockMemory += counted.blockMemory;
+			m_Stats.MeshMemory += counted.meshMemory;
+			m_Stats.Vertices += counted.vertices;
+			m_Stats.PerLod[counted.lod]++;
+			return;
+		}
+
+		m_Stats.BlockMemory -= counted.blockMemory;
+		m_Stats.MeshMemory -= counted.meshMemory;
+		m_Stats.Vertices -= counted.vertices;
+		m_Stats.PerLod[counted.lod]--;
+	}
+
+	void ChunkStreamer::_RemoveDrawable(Slot& slot)
+	{
+		if (slot.drawIndex < 0)
+		{
+			return;
+		}
+
+		_CountDrawable(slot, false);
+		Slot* last = m_Drawable.back();
+		m_Drawable[slot.drawIndex] = last;
+		last->drawIndex = slot.drawIndex;
+		m_Drawable.pop_back();
+		slot.drawIndex = -1;
+	}
+
+	int ChunkStreamer::_LodFor(const Vec2& coord) const
+	{
+		if (m_Settings.LodDistance <= 0)
+		{
+			return 0;
+		}
+
+		const int maxLod = std::min(m_Settings.MaxLod, Chunk::MaxLod(m_Settings.ChunkSize));
+		const int dx = coord.x - m_Center.x;
+		const int dz = coord.y - m_Center.y;
+		const int d2 = dx * dx + dz * dz;
+
+		int lod = 0;
+		while (lod < maxLod)
+		{
+			const int ring = m_Settings.LodDistance << lod;
+			if (d2 < ring * ring)
+			{
+				break;
+			}
+			lod++;
+		}
+		return lod;
+	}
+
+	uint8_t ChunkStreamer::_SkirtsFor(const Vec2& coord, int lod) const
+	{
+		struct Neighbour { Chunk::Face face; int dx, dz; };
+		static constexpr Neighbour Neighbours[4] = {
+			{ Chunk::Face::LEFT, 1, 0 },
+			{ Chunk::Face::RIGHT, -1, 0 },
+			{ Chunk::Face::FRONT, 0, 1 },
+			{ Chunk::Face::BACK, 0, -1 },
+		};
+
+		uint8_t mask = 0;
+		for (auto& n : Neighbours)
+		{
+			if (_LodFor({ coord.x + n.dx, coord.y + n.dz }) != lod)
+			{
+				mask |= 1 << static_cast<int>(n.face);
+			}
+		}
+		return mask;
+	}
+
+	void ChunkStreamer::_DrainCompleted()
+	{
+		Completion next;
+		while (m_Completed->TryGet(next))
+		{
+			m_Stats.ScratchJobs++;
+			m_Stats.ScratchArenaBytes += next.scratch.ArenaBytes;
+			m_Stats.ScratchHeapBytes += next.scratch.HeapBytes;
+			m_Draining.push_back(next);
+		}
+
+		size_t kept = 0;
+		for (auto& completion : m_Draining)
+		{
+			// Other tickets belong to slots unloaded while their job ran,
+			// they are released from m_Retiring once the job returned
+			auto itr = m_Loaded.find(completion.coord);
+			if (itr == m_Loaded.end() || itr->second.ticket != completion.ticket || !itr->second.job.IsValid())
+			{
+				for (auto& retired : m_Retiring)
+				{
+					retired.completed |= retired.ticket == completion.ticket;
+				}
+				continue;
+			}
+
+			// Pushed right before the coroutine returns, it's collected next time
+			if (!itr->second.job.IsDone())
+			{
+				m_Draining[kept++] = completion;
+				continue;
+			}
+			_FinishJob(completion.coord, itr->second);
+		}
+		m_Draining.resize(kept);
+
+		_FlushUploads();
+	}
+
+	void ChunkStreamer::_FlushUploads()
+	{
+		if (m_Uploads.empty())
+		{
+			return;
+		}
+
+		Chunk::SendToGpu(m_Uploads);
+		m_Uploads.clear();
+	}
+
+	void ChunkStreamer::_ReleaseRetired()
+	{
+		for (auto itr = m_Retiring.begin(); itr != m_Retiring.end();)
+		{
+			// Counted in flight until its completion left the queue
+			if (_JobRunning(*itr) || !itr->completed)
+			{
+				++itr;
+				continue;
+			}
+
+			_CollectJob(*itr);
+			_RecycleChunk(std::move(itr->chunk));
+			_RecycleChunk(std::move(itr->building));
+			itr = m_Retiring.erase(itr);
+		}
+	}
+
+	void ChunkStreamer::_UnloadFar()
+	{
+		m_UnloadPending = false;
+		const int r2 = m_Settings.UnloadRadius * m_Settings.UnloadRadius;
+		const int load2 = m_Settings.LoadRadius * m_Settings.LoadRadius;
+
+		for (auto itr = m_Loaded.begin(); itr != m_Loaded.end();)
+		{
+			const int dx = itr->first.x - m_Center.x;
+			const int dz = itr->first.y - m_Center.y;
+			const int d2 = dx * dx + dz * dz;
+
+			if (d2 <= r2)
+			{
+				// Not worth finishing once the camera moved away from it
+				if (d2 > load2 && itr->second.job.IsValid() && itr->second.epoch != 0)
+				{
+					_CancelJob(itr->second);
+				}
+				++itr;
+				continue;
+			}
+
+			_SaveModified(itr->first, itr->second);
+			_RemoveDrawable(itr->second);
+			if (itr->second.job.IsValid())
+			{
+				itr->second.token.Cancel();
+				m_Retiring.push_back(std::move(itr->second));
+			}
+			else
+			{
+				_RecycleChunk(std::move(itr->second.chunk));
+			}
+			itr = m_Loaded.erase(itr);
+		}
+	}
+
+	void ChunkStreamer::_TrimPool()
+	{
+		// Loaded chunks never exceed the unload disk and every job takes one
+		// spare, anything pooled past that would never be reused
+		const size_t maxChunks = m_MaxChunks + m_Settings.MaxJobsInFlight;
+		const size_t maxPooled = maxChunks > m_Loaded.size() ? maxChunks - m_Loaded.size() : 0;
+		if (m_Pool.size() > maxPooled)
+		{
+			m_Pool.resize(maxPooled);
+		}
+	}
+
+	void ChunkStreamer::_QueueMissing()
+	{
+		int budget = std::min(
+			m_Settings.MaxNewJobsPerUpdate,
+			m_Settings.MaxJobsInFlight - m_InFlight
+		);
+
+		m_QueuePending = false;
+		m_Batch.clear();
+		for (; m_QueueCursor < m_LoadOffsets.size(); m_QueueCursor++)
+		{
+			// Picks up at the cursor once a job finished
+			if (budget <= 0)
+			{
+				m_QueuePending = true;
+				break;
+			}
+
+			const Vec2& offset = m_LoadOffsets[m_QueueCursor];
+			const Vec2 coord{ m_Center.x + offset.x, m_Center.y + offset.y };
+			const int lod = _LodFor(coord);
+			const uint8_t skirts = _SkirtsFor(coord, lod);
+			auto itr = m_Loaded.find(coord);
+
+			if (itr == m_Loaded.end())
+			{
+				itr = m_Loaded.emplace(coord, Slot{}).first;
+			}
+			else if (itr->second.job.IsValid() ||
+				(itr->second.epoch == m_Epoch && itr->second.lod == lod && itr->second.skirts == skirts))
+			{
+				continue;
+			}
+
+			_PrepareSlot(coord, itr->second, lod, skirts);
+			m_Batch.push_back(coord);
+			budget--;
+		}
+
+		if (!m_Batch.empty())
+		{
+			_LaunchBatch(m_Batch);
+		}
+	}
+
+	void ChunkStreamer::_PrepareSlot(const Vec2& coord, Slot& slot, int lod, uint8_t skirts)
+	{
+		// The job loads the edits back from the store
+		_SaveModified(coord, slot);
+
+		slot.building = _AcquireChunk();
+		Chunk* chunk = slot.building.get();
+		chunk->SetOffset(coord.x, coord.y);
+		chunk->SetMeshingMode(m_Settings.Meshing);
+		chunk->SetLod(lod);
+		chunk->SetSkirtMask(skirts);
+
+		slot.epoch = m_Epoch;
+		slot.lod = chunk->GetLod();
+		slot.skirts = skirts;
+		slot.token = System::CancellationToken::Create();
+		slot.ticket = m_NextTicket++;
+		slot.completed = false;
+	}
+
+	void ChunkStreamer::_LaunchBatch(const std::vector<Vec2>& coords)
+	{
+		PR_ASSERT(m_HeightSource, "(ChunkStreamer) No height source present!");
+
+		auto batch = MakeRef<Batch>();
+		batch->jobs = std::vector<Batch::Job>(coords.size());
+		batch->graph = MakeRef<System::TaskGraph>(m_Worker);
+		batch->completed = m_Completed;
+		batch->cache = m_HeightCache;
+		batch->params = m_NoiseParams;
+		batch->source = m_HeightSource;
+		batch->size = m_Settings.ChunkSize;
+
+		for (size_t i = 0; i < coords.size(); i++)
+		{
+			Slot& slot = m_Loaded.at(coords[i]);
+			auto& job = batch->jobs[i];
+			job.chunk = slot.building.get();
+			job.coord = coords[i];
+			job.ticket = slot.ticket;
+			job.token = slot.token;
+			// Only full resolution chunks are stored, lower lods are cheap to generate
+			job.store = slot.lod == 0 ? m_Store : nullptr;
+
+			const int dx = job.coord.x - m_Center.x;
+			const int dz = job.coord.y - m_Center.y;
+			job.priority = dx * dx + dz * dz;
+
+			using Affinity = System::TaskGraph::Affinity;
+			job.populate = batch->graph->Add(Affinity::WORKER, job.priority);
+			job.mesh = batch->graph->Then(job.populate, Affinity::WORKER, job.priority);
+			// Only hands the chunk back, runs on whichever thread left the last mesh
+			job.done = batch->graph->Then(job.mesh, Affinity::ANY);
+
+			for (int face = 0; face < 4; face++)
+			{
+				const Vec2 next{ job.coord.x + FaceDirections[face][0], job.coord.y + FaceDirections[face][1] };
+				auto itr = std::find(coords.begin(), coords.end(), next);
+				if (itr != coords.end())
+				{
+					if (m_Loaded.at(next).lod == slot.lod)
+					{
+						job.neighbours[face] = static_cast<int>(itr - coords.begin());
+					}
+					continue;
+				}
+
+				// Loaded neighbours carry their edits and saved heights, the sampled halo doesn't
+				const Chunk* ready = FindReadyChunk(next);
+				if (ready && ready->GetLod() == slot.lod)
+				{
+					ready->GetBorder(Chunk::Opposite(static_cast<Chunk::Face>(face)), job.borders[face]);
+				}
+			}
+		}
+
+		// Linked once every job has its nodes
+		for (auto& job : batch->jobs)
+		{
+			for (int n : job.neighbours)
+			{
+				if (n >= 0)
+				{
+					batch->graph->Precede(batch->jobs[n].populate, job.mesh);
+					batch->graph->Precede(batch->jobs[n].mesh, job.done);
+				}
+			}
+		}
+
+		// The graph is complete before the first job enters a node
+		for (size_t i = 0; i < coords.size(); i++)
+		{
+			Slot& slot = m_Loaded.at(coords[i]);
+			slot.job = _GenerateChunk(batch, i);
+			slot.job.Start();
+			m_InFlight++;
+		}
+	}
+
+	System::Task<void> ChunkStreamer::_GenerateChunk(Ref<Batch> batch, size_t index)
+	{
+		auto& job = batch->jobs[index];
+		System::TaskGraph& graph = *batch->graph;
+		co_await graph.Enter(job.populate);
+
+		// Held back until every stage was left, the neighbours would wait forever otherwise
+		std::exception_ptr error;
+		// Every stage takes its scratch from the arena of the worker it runs on
+		// and releases it before it suspends, the next stage may run on another one
+		Utils::ScratchArena::Usage scratch;
+		try
+		{
+			Utils::ScratchScope scope;
+			if (!job.token.IsCancelled())
+			{
+				Chunk* chunk = job.chunk;
+				chunk->Allocate();
+				chunk->SetHeightSource(batch->source);
+				if (!job.store || !job.store->Load(job.coord, *chunk))
+				{
+					// Lods sample a subset of the tile, only their halo falls back to the source
+					if (batch->cache)
+					{
+						chunk->Populate(CachedHeightSource(batch->cache->Acquire(batch->params, job.coord, batch->size, *batch->source), *batch->source));
+					}
+					else
+					{
+						chunk->Populate();
+					}
+					if (job.store)
+					{
+						std::vector<uint8_t> payload;
+						chunk->Serialize(payload);
+						job.store->Save(job.coord, std::move(payload));
+					}
+				}
+				job.populated = true;
+			}
+			scratch += scope.GetUsage();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		graph.Leave(job.populate);
+		co_await graph.Enter(job.mesh);
+
+		try
+		{
+			Utils::ScratchScope scope;
+			if (job.populated && !job.token.IsCancelled())
+			{
+				// Neighbours carry their edits and saved heights, the sampled halo doesn't
+				const Chunk* neighbours[4] = { nullptr, nullptr, nullptr, nullptr };
+				for (int face = 0; face < 4; face++)
+				{
+					const int n = job.neighbours[face];
+					if (n >= 0 && batch->jobs[n].populated)
+					{
+						neighbours[face] = batch->jobs[n].chunk;
+					}
+				}
+				job.chunk->CopyHalo(neighbours);
+				for (int face = 0; face < 4; face++)
+				{
+					if (!job.borders[face].empty())
+					{
+						job.chunk->SetHalo(static_cast<Chunk::Face>(face), job.borders[face]);
+					}
+				}
+				job.chunk->GenerateMesh();
+			}
+			scratch += scope.GetUsage();
+		}
+		catch (...)
+		{
+			error = error ? error : std::current_exception();
+		}
+
+		graph.Leave(job.mesh);
+
+		// A chunk can only be recycled once the neighbours meshing against it are done,
+		// cancelled jobs complete as well so their slot is collected
+		co_await graph.Enter(job.done);
+		// Has a free cell, see CompletionQueue
+		batch->completed->Put(Completion{ job.coord, job.ticket, scratch });
+		graph.Leave(job.done);
+
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+
+	void ChunkStreamer::_BuildLoadOffsets()
+	{
+		const int r = m_Settings.LoadRadius;
+		const int ur = m_Settings.UnloadRadius;
+		m_LoadOffsets.clear();
+		m_MaxChunks = 0;
+
+		for (int x = -ur; x <= ur; x++)
+		{
+			for (int z = -ur; z <= ur; z++)
+			{
+				m_MaxChunks += (x * x + z * z <= ur * ur);
+			}
+		}
+
+		for (int x = -r; x <= r; x++)
+		{
+			for (int z = -r; z <= r; z++)
+			{
+				if (x * x + z * z <= r * r)
+				{
+					m_LoadOffsets.push_back({ x, z });
+				}
+			}
+		}
+
+		std::stable_sort(m_LoadOffsets.begin(), m_LoadOffsets.end(), [](const Vec2& a, const Vec2& b)
+			{
+				return a.x * a.x + a.y * a.y < b.x * b.x + b.y * b.y;
+			});
+	}
+
+	Ptr<Chunk> ChunkStreamer::_AcquireChunk()
+	{
+		if (!m_Pool.empty())
+		{
+			auto chunk = std::move(m_Pool.back());
+			m_Pool.pop_back();
+			return chunk;
+		}
+
+		return MakePtr<Chunk>(m_Settings.ChunkSize, m_Settings.BlockSize, m_Settings.Format);
+	}
+
+	void ChunkStreamer::_RecycleChunk(Ptr<Chunk> chunk)
+	{
+		if (!chunk)
+		{
+			return;
+		}
+
+		chunk->Recycle();
+		m_Pool.push_back(std::move(chunk));
+	}
+
+	void ChunkStreamer::_RestartQueue()
+	{
+		m_QueueCursor = 0;
+		m_QueuePending = true;
+	}
+
+	void ChunkStreamer::_DropAll()
+	{
+		for (auto& [coord, slot] : m_Loaded)
+		{
+			_SaveModified(coord, slot);
+		}
+		m_Edited.clear();
+		PR_ASSERT(m_InFlight == 0, "(ChunkStreamer) Dropping chunks with jobs in flight");
+		for (auto* slot : m_Drawable)
+		{
+			_CountDrawable(*slot, false);
+		}
+		m_Drawable.clear();
+		m_Loaded.clear();
+		m_Retiring.clear();
+		m_Pool.clear();
+	}
+
+	void ChunkStreamer::_UpdateStats()
+	{
+		// Memory, vertex and lod totals are kept up to date by _AddDrawable and _RemoveDrawable
+		m_Stats.Loaded = static_cast<int>(m_Loaded.size());
+		m_Stats.InFlight = m_InFlight;
+		m_Stats.Pooled = static_cast<int>(m_Pool.size());
+		m_Stats.Retiring = static_cast<int>(m_Retiring.size());
+		m_Stats.Ready = static_cast<int>(m_Drawable.size());
+	}
+}
@@ -0,0 +1,254 @@
+#pragma once
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "Chunk.h"
+#include "HeightCache.h"
+#include "Ray.h"
+#include "RegionFile.h"
+#include "prism/Core/Pointers.h"
+#include "prism/Renderer/Frustum.h"
+#include "prism/System/CancellationToken.h"
+#include "prism/System/Task.h"
+#include "prism/System/ThreadPool.h"
+#include "prism/Utils/BoundedQueue.h"
+#include "prism/Utils/ScratchArena.h"
+
+namespace Prism::Voxel
+{
+	// Keeps the chunks inside a radius around a position loaded.
+	// Missing chunks are queued closest first on a worker pool with their
+	// distance as priority, chunks past the unload radius are recycled into a
+	// pool instead of being destroyed. Jobs of chunks that left the load radius
+	// or belong to a regenerated world are cancelled.
+	// A job builds into a spare chunk from the pool, the slot keeps drawing
+	// its old chunk until the new mesh is uploaded and the two are swapped.
+	// Every chunk Update queues is generated by a coroutine on the worker pool:
+	// all of them populate in parallel, a chunk meshes once its neighbours in
+	// the same batch populated and takes their border columns as its halo.
+	// Borders of meshed neighbours outside the batch are copied when it's
+	// queued, the halos of neighbours that finished later are exchanged and
+	// remeshed when the job is drained.
+	// Finished jobs push themselves to a bounded completion queue with a cell
+	// for every job in flight. Update only visits those, uploads them in one
+	// batch and adds them to the drawable list the draw calls walk. The worker
+	// pool must not drop tasks while jobs are queued (Abort, CancelPendingTasks),
+	// their coroutines would never finish.
+	// With a store set full resolution chunks are loaded from it when present,
+	// freshly generated ones and edited ones are saved to it.
+	// All functions have to be called from the thread that owns the gl context
+	class ChunkStreamer
+	{
+	public:
+		struct Settings
+		{
+			int ChunkSize{ 32 };
+			int BlockSize{ 4 };
+			Chunk::VertexFormat Format{ Chunk::VertexFormat::PACKED };
+			Chunk::MeshingMode Meshing{ Chunk::MeshingMode::GREEDY };
+			// Radii are in chunks, UnloadRadius > LoadRadius avoids
+			// chunks flickering in and out on a chunk border
+			int LoadRadius{ 8 };
+			int UnloadRadius{ 10 };
+			int MaxJobsInFlight{ 8 };
+			int MaxNewJobsPerUpdate{ 4 };
+			// Chunks further than LodDistance << (lod - 1) chunks use lod,
+			// 0 keeps every chunk at full resolution
+			int LodDistance{ 4 };
+			int MaxLod{ 3 };
+		};
+
+		struct Stats
+		{
+			int Loaded{ 0 };
+			int Ready{ 0 };
+			int InFlight{ 0 };
+			int Pooled{ 0 };
+			int Retiring{ 0 };
+			size_t BlockMemory{ 0 };
+			size_t MeshMemory{ 0 };
+			size_t Vertices{ 0 };
+			int PerLod[4]{ 0, 0, 0, 0 };
+			// From the last ForEachVisible
+			int Drawn{ 0 };
+			int Culled{ 0 };
+			// Remesh and upload time of the edits and halo updates applied in the last Update
+			long long EditNanoseconds{ 0 };
+			int EditedChunks{ 0 };
+			// Scratch of every finished job, ScratchHeapBytes should stay
+			// near zero once the workers' arenas have grown
+			size_t ScratchJobs{ 0 };
+			size_t ScratchArenaBytes{ 0 };
+			size_t ScratchHeapBytes{ 0 };
+		};
+
+		ChunkStreamer(Ref<System::ThreadPool> worker);
+		~ChunkStreamer();
+
+		// Size, block size or format changes drop every chunk,
+		// everything else is applied to the already loaded chunks
+		void Configure(const Settings& settings);
+		void SetHeightSource(Ref<const IHeightSource> source);
+		// Chunks that are generated sample their tile through the cache, params
+		// have to describe the current height source. nullptr disables it
+		void SetHeightCache(Ref<HeightCache> cache, const NoiseParams& params);
+		// Edited chunks are saved to the previous store before it is replaced,
+		// nullptr disables persistence
+		void SetStore(Ref<RegionStore> store);
+		// Loaded chunks keep rendering their old mesh until they are rebuilt,
+		// jobs that haven't finished are cancelled
+		void Regenerate();
+		void Update(const glm::vec3& position);
+		// Calls back with every uploaded chunk
+		void ForEachReady(const std::function<void(Chunk&)>& func);
+		// Same as ForEachReady but skips chunks outside the frustum,
+		// all ready chunks are tested in one batch before the first callback
+		void ForEachVisible(const Renderer::Frustum& frustum, const std::function<void(Chunk&)>& func);
+		// Blocks until every queued job has finished
+		void WaitForJobs();
+
+		// Coordinates are full resolution blocks in world space, see Chunk::SetBlock.
+		// Only meshed chunks at lod 0 can be edited. Without a store edits last
+		// until the chunk gets unloaded or rebuilt. Meshes are updated in the next Update
+		bool SetBlock(int x, int level, int z, Chunk::BlockType type);
+		// Surface level of the column, -1 when it isn't editable
+		int GetSurfaceLevel(int x, int z);
+
+		// Meshed chunk at the coordinate or nullptr
+		const Chunk* FindReadyChunk(const Vec2& coord) const;
+		// Traces against the ready chunks, valid until the next Update
+		Raycaster GetRaycaster() const;
+
+		Vec2 GetCenter() const { return m_Center; }
+		const Settings& GetSettings() const { return m_Settings; }
+		const Stats& GetStats() const { return m_Stats; }
+	private:
+		// What a drawable chunk adds to the running totals in Stats
+		struct Footprint
+		{
+			size_t blockMemory{ 0 };
+			size_t meshMemory{ 0 };
+			size_t vertices{ 0 };
+			int lod{ 0 };
+		};
+
+		struct Slot
+		{
+			// Drawn and edited, nullptr until the first job finished
+			Ptr<Chunk> chunk;
+			// Written by the job, swapped with chunk once it's meshed
+			Ptr<Chunk> building;
+			// Done once the mesh is built and no neighbour reads its heights anymore
+			System::Task<void> job;
+			System::CancellationToken token;
+			// Of the last queued job, the drawn chunk has its own until the swap
+			uint32_t epoch{ 0 };
+			int lod{ 0 };
+			uint8_t skirts{ 0 };
+			// Tells a completion apart from the ones of earlier jobs of this slot
+			uint64_t ticket{ 0 };
+			// Index in m_Drawable, -1 while not drawable
+			int drawIndex{ -1 };
+			// Edited since it was loaded or saved
+			bool modified{ false };
+			// The completion of the job was drained, a retiring slot waits for it
+			bool completed{ false };
+			// Added to the totals in m_Stats while drawable
+			Footprint counted;
+		};
+
+		struct Completion
+		{
+			Vec2 coord{ 0, 0 };
+			uint64_t ticket{ 0 };
+			Utils::ScratchArena::Usage scratch;
+		};
+
+		// Filled by the end of every job, drained by Update. A job keeps its
+		// slot counted in flight until its completion was taken, so the queue
+		// never holds more than MaxJobsInFlight and workers never wait on it
+		using CompletionQueue = Utils::BoundedQueue<Completion>;
+
+		// Shared by the jobs queued in one Update
+		struct Batch;
+
+		static System::Task<void> _GenerateChunk(Ref<Batch> batch, size_t index);
+
+		Vec2 _WorldToChunk(const glm::vec3& position) const;
+		bool _JobRunning(const Slot& slot) const;
+		// Marks the slot stale so it's queued again when it's needed
+		void _CancelJob(Slot& slot);
+		// False when the job threw, the error is logged and the slot marked stale
+		bool _CollectJob(Slot& slot);
+		// Collects the job and queues the upload of its mesh
+		void _FinishJob(const Vec2& coord, Slot& slot);
+		// Exchanges border columns with the idle neighbours at the same lod,
+		// chunks whose halo changed are queued for a rebuild
+		void _SyncHalos(const Vec2& coord, Slot& slot);
+		// Adds the slot or counts it again after its chunk was swapped or remeshed
+		void _AddDrawable(Slot& slot);
+		void _RemoveDrawable(Slot& slot);
+		void _CountDrawable(const Slot& slot, bool add);
+		int _LodFor(const Vec2& coord) const;
+		uint8_t _SkirtsFor(const Vec2& coord, int lod) const;
+		Slot* _EditableSlot(const Vec2& coord);
+		void _MarkEdited(Slot& slot);
+		// Remeshes the dirty sections in the next Update without saving the chunk
+		void _QueueRebuild(Slot& slot);
+		void _SaveModified(const Vec2& coord, Slot& slot);
+		void _RebuildEdited();
+		void _DrainCompleted();
+		void _FlushUploads();
+		void _UnloadFar();
+		void _TrimPool();
+		void _ReleaseRetired();
+		void _QueueMissing();
+		// Walks the load offsets from the closest one again in the next Update
+		void _RestartQueue();
+		void _PrepareSlot(const Vec2& coord, Slot& slot, int lod, uint8_t skirts);
+		void _LaunchBatch(const std::vector<Vec2>& coords);
+		void _BuildLoadOffsets();
+		Ptr<Chunk> _AcquireChunk();
+		void _RecycleChunk(Ptr<Chunk> chunk);
+		void _DropAll();
+		void _UpdateStats();
+
+		Settings m_Settings;
+		Ref<System::ThreadPool> m_Worker;
+		Ref<CompletionQueue> m_Completed;
+		Ref<RegionStore> m_Store;
+		Ref<HeightCache> m_HeightCache;
+		NoiseParams m_NoiseParams;
+		Ref<const IHeightSource> m_HeightSource;
+		std::unordered_map<Vec2, Slot> m_Loaded;
+		// Unloaded while a job was still using them
+		std::vector<Slot> m_Retiring;
+		std::vector<Ptr<Chunk>> m_Pool;
+		// Chunk offsets inside the load radius, closest first
+		std::vector<Vec2> m_LoadOffsets;
+		// Chunks inside the unload radius, caps loaded + pooled
+		size_t m_MaxChunks{ 0 };
+		Vec2 m_Center{ 0, 0 };
+		bool m_UnloadPending{ true };
+		bool m_QueuePending{ true };
+		// Load offsets before it were loaded or queued at this center and epoch
+		size_t m_QueueCursor{ 0 };
+		uint32_t m_Epoch{ 1 };
+		int m_InFlight{ 0 };
+		Stats m_Stats;
+		Renderer::FrustumCuller m_Culler;
+		std::vector<Chunk*> m_CullList;
+		// Slots stay in place until Update unloads them, m_Edited is empty by then
+		std::vector<Slot*> m_Edited;
+		std::vector<int> m_Border;
+		std::vector<Vec2> m_Batch;
+		// Taken from the completion queue so workers never wait on the drain,
+		// keeps the completions of jobs that haven't returned yet
+		std::vector<Completion> m_Draining;
+		std::vector<Chunk*> m_Uploads;
+		// Idle slots with an uploaded mesh, unordered
+		std::vector<Slot*> m_Drawable;
+		uint64_t m_NextTicket{ 1 };
+	};
+}
@@ -0,0 +1,142 @@
+#include "HeightCache.h"
+
+#include <cstring>
+
+namespace Prism::Voxel
+{
+	HeightCache::HeightCache(size_t budget)
+	{
+		m_Stats.Budget = budget;
+	}
+
+	Ref<const HeightCache::Tile> HeightCache::Acquire(const NoiseParams& params, const Vec2& coord, int size, const IHeightSource& source)
+	{
+		const Key key{ params, coord, size };
+		{
+			std::lock_guard<std::mutex> lck(m_Mutex);
+			auto itr = m_Tiles.find(key);
+			if (itr != m_Tiles.end())
+			{
+				m_Lru.splice(m_Lru.begin(), m_Lru, itr->second);
+				m_Stats.Hits++;
+				return itr->second->second;
+			}
+			m_Stats.Misses++;
+		}
+
+		// Sampled without the lock, the noise is the expensive part
+		auto tile = MakeRef<Tile>();
+		tile->Size = size;
+		tile->X = coord.x * size - 1;
+		tile->Z = coord.y * size - 1;
+		tile->Samples.resize((size + 2) * (size + 2));
+		source.FillRegion({ tile->X, tile->Z, size + 2, size + 2 }, tile->Samples.data());
+
+		std::lock_guard<std::mutex> lck(m_Mutex);
+		auto [itr, inserted] = m_Tiles.emplace(key, m_Lru.end());
+		if (!inserted)
+		{
+			// Another job sampled the same tile in the meantime
+			return itr->second->second;
+		}
+
+		m_Lru.emplace_front(key, tile);
+		itr->second = m_Lru.begin();
+		m_Stats.Memory += _TileMemory(*tile);
+		_Evict();
+		return tile;
+	}
+
+	void HeightCache::SetBudget(size_t budget)
+	{
+		std::lock_guard<std::mutex> lck(m_Mutex);
+		m_Stats.Budget = budget;
+		_Evict();
+	}
+
+	void HeightCache::Clear()
+	{
+		std::lock_guard<std::mutex> lck(m_Mutex);
+		m_Tiles.clear();
+		m_Lru.clear();
+		m_Stats.Memory = 0;
+	}
+
+	HeightCache::Stats HeightCache::GetStats()
+	{
+		std::lock_guard<std::mutex> lck(m_Mutex);
+		Stats stats = m_Stats;
+		stats.Tiles = m_Tiles.size();
+		return stats;
+	}
+
+	size_t HeightCache::KeyHash::operator()(const Key& key) const
+	{
+		auto Bits = [](float f)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &f, sizeof(bits));
+			return bits;
+		};
+
+		const uint32_t Values[] = {
+			Bits(key.Params.Scale), Bits(key.Params.XOffset), Bits(key.Params.YOffset),
+			key.Params.Octaves, Bits(key.Params.Persistence),
+			static_cast<uint32_t>(key.Params.Graph), static_cast<uint32_t>(key.Params.Graph >> 32),
+			static_cast<uint32_t>(key.Coord.x), static_cast<uint32_t>(key.Coord.y), static_cast<uint32_t>(key.Size)
+		};
+
+		size_t hash = 0;
+		for (auto value : Values)
+		{
+			hash ^= std::hash<uint32_t>{}(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		}
+		return hash;
+	}
+
+	void HeightCache::_Evict()
+	{
+		// The newest tile always stays, even if it alone is over budget
+		while (m_Stats.Memory > m_Stats.Budget && m_Lru.size() > 1)
+		{
+			auto& [key, tile] = m_Lru.back();
+			m_Stats.Memory -= _TileMemory(*tile);
+			m_Stats.Evictions++;
+			m_Tiles.erase(key);
+			m_Lru.pop_back();
+		}
+	}
+
+	size_t HeightCache::_TileMemory(const Tile& tile)
+	{
+		return sizeof(Tile) + tile.Samples.capacity() * sizeof(float);
+	}
+
+	CachedHeightSource::CachedHeightSource(Ref<const HeightCache::Tile> tile, const IHeightSource& fallback)
+		:
+		m_Tile(std::move(tile)),
+		m_Fallback(fallback)
+	{}
+
+	void CachedHeightSource::FillRegion(const HeightRegion& region, float* out) const
+	{
+		for (int z = 0; z < region.Height; z++)
+		{
+			for (int x = 0; x < region.Width; x++)
+			{
+				const int sx = region.X + x * region.Step;
+				const int sz = region.Z + z * region.Step;
+				if (m_Tile->Contains(sx, sz))
+				{
+					*out = m_Tile->Get(sx, sz);
+				}
+				else
+				{
+					// Only the halo of lower lods ends up here
+					m_Fallback.FillRegion({ sx, sz, 1, 1 }, out);
+				}
+				out++;
+			}
+		}
+	}
+}
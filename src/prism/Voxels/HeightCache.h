@@ -0,0 +1,99 @@
+#pragma once
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Chunk.h"
+#include "HeightSource.h"
+#include "PerlinHeightSource.h"
+#include "prism/Core/Pointers.h"
+
+namespace Prism::Voxel
+{
+	// Height source samples of one chunk sized tile, kept in memory so
+	// regenerating or revisiting terrain skips the noise. Tiles include a one
+	// sample border on every side which covers the halo of full resolution chunks.
+	// Least recently used tiles are evicted once the budget is exceeded
+	class HeightCache
+	{
+	public:
+		struct Tile
+		{
+			int Size{ 0 };
+			// Sample coordinate of Samples[0]
+			int X{ 0 };
+			int Z{ 0 };
+			std::vector<float> Samples;
+
+			bool Contains(int x, int z) const
+			{
+				return x >= X && z >= Z && x < X + Size + 2 && z < Z + Size + 2;
+			}
+
+			float Get(int x, int z) const
+			{
+				return Samples[(z - Z) * (Size + 2) + (x - X)];
+			}
+		};
+
+		struct Stats
+		{
+			size_t Hits{ 0 };
+			size_t Misses{ 0 };
+			size_t Evictions{ 0 };
+			size_t Tiles{ 0 };
+			size_t Memory{ 0 };
+			size_t Budget{ 0 };
+		};
+
+		HeightCache(size_t budget);
+
+		// Thread safe. Returns the cached tile or fills a new one from source in
+		// a single region, a tile evicted while in use stays valid for its holders
+		Ref<const Tile> Acquire(const NoiseParams& params, const Vec2& coord, int size, const IHeightSource& source);
+
+		void SetBudget(size_t budget);
+		void Clear();
+		Stats GetStats();
+	private:
+		struct Key
+		{
+			NoiseParams Params;
+			Vec2 Coord;
+			int Size;
+
+			bool operator==(const Key& other) const
+			{
+				return Params == other.Params && Coord == other.Coord && Size == other.Size;
+			}
+		};
+
+		struct KeyHash
+		{
+			size_t operator()(const Key& key) const;
+		};
+
+		using LruList = std::list<std::pair<Key, Ref<const Tile>>>;
+
+		void _Evict();
+		static size_t _TileMemory(const Tile& tile);
+
+		std::mutex m_Mutex;
+		LruList m_Lru;
+		std::unordered_map<Key, LruList::iterator, KeyHash> m_Tiles;
+		Stats m_Stats;
+	};
+
+	// Serves regions from a cached tile, samples outside of it come from the fallback
+	class CachedHeightSource final : public IHeightSource
+	{
+	public:
+		CachedHeightSource(Ref<const HeightCache::Tile> tile, const IHeightSource& fallback);
+
+		void FillRegion(const HeightRegion& region, float* out) const override;
+	private:
+		Ref<const HeightCache::Tile> m_Tile;
+		const IHeightSource& m_Fallback;
+	};
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+
+namespace Prism::Voxel
+{
+	// Rectangle of columns, sample (x, z) is column (X + x * Step, Z + z * Step)
+	struct HeightRegion
+	{
+		int X{ 0 };
+		int Z{ 0 };
+		int Width{ 0 };
+		int Height{ 0 };
+		int Step{ 1 };
+
+		size_t Count() const
+		{
+			return static_cast<size_t>(Width) * Height;
+		}
+	};
+
+	// Produces population values in [0, 1] for a whole region of columns per call,
+	// so generators can tile and vectorise internally. Chunk jobs share one
+	// source, FillRegion has to be thread safe
+	class IHeightSource
+	{
+	public:
+		virtual ~IHeightSource() = default;
+		// out holds region.Count() values, row by row
+		virtual void FillRegion(const HeightRegion& region, float* out) const = 0;
+	};
+
+	// Adapts a per column callable float(int x, int z), for tests and simple generators
+	template<typename F>
+	class FunctionHeightSource final : public IHeightSource
+	{
+	public:
+		FunctionHeightSource(F func)
+			:
+			m_Func(std::move(func))
+		{}
+
+		void FillRegion(const HeightRegion& region, float* out) const override
+		{
+			for (int z = 0; z < region.Height; z++)
+			{
+				for (int x = 0; x < region.Width; x++)
+				{
+					*out++ = m_Func(region.X + x * region.Step, region.Z + z * region.Step);
+				}
+			}
+		}
+	private:
+		F m_Func;
+	};
+}
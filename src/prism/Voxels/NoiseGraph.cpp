@@ -0,0 +1,461 @@
+#include "NoiseGraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <nlohmann/json.hpp>
+
+#include "prism/Math/Interpolation.h"
+#include "prism/Math/Smoothing.h"
+#include "prism/System/FileIO.h"
+#include "prism/System/Log.h"
+#include "prism/Utils/ScratchArena.h"
+
+namespace Prism::Voxel
+{
+	namespace
+	{
+		// Register 0 is the output, the rest come from the per thread scratch
+		constexpr int MaxRegisters = 32;
+		constexpr int MaxOctaves = 16;
+
+		Math::prdecimal LinearCurve(Math::prdecimal t)
+		{
+			return t;
+		}
+
+		// Shared by the tile and the per sample path so warped and unwarped ridges match
+		inline float RidgeOctave(float noise, float& weight, float amplitude, float ridge, float gain)
+		{
+			float signal = ridge - std::fabs(noise);
+			signal *= signal;
+			signal *= weight;
+			weight = std::clamp(signal * gain, 0.f, 1.f);
+			return signal * amplitude;
+		}
+
+		struct GraphError : std::runtime_error
+		{
+			using std::runtime_error::runtime_error;
+		};
+	}
+
+	struct NoiseGraph::Compiler
+	{
+		using json = nlohmann::json;
+
+		NoiseGraph& Graph;
+
+		// Emits the ops leaving the node's value in register slot,
+		// returns the highest register the node touches
+		int Compile(const json& node, int slot)
+		{
+			if (slot >= MaxRegisters - 2)
+			{
+				throw GraphError("graph is nested too deep");
+			}
+
+			if (node.is_number())
+			{
+				Op op;
+				op.Run = &NoiseGraph::_RunConstant;
+				op.Out = slot;
+				op.Params[0] = node.get<float>();
+				Graph.m_Ops.push_back(op);
+				return slot;
+			}
+
+			if (!node.is_object() || !node.contains("type"))
+			{
+				throw GraphError("expected a number or a node with a type: " + node.dump());
+			}
+
+			const std::string type = node["type"].get<std::string>();
+			if (type == "perlin" || type == "ridged")
+			{
+				Op op;
+				op.Run = &NoiseGraph::_RunGenerator;
+				op.Out = slot;
+				// Ridged noise keeps its signal and weight next to the output
+				op.In[0] = slot + 1;
+				op.In[1] = slot + 2;
+				op.Generator = AddGenerator(node);
+				Graph.m_Ops.push_back(op);
+				return type == "ridged" ? slot + 2 : slot;
+			}
+
+			if (type == "warp")
+			{
+				const int generator = AddGenerator(Input(node, "input"));
+				const int highest = std::max(Compile(Input(node, "x"), slot + 1), Compile(Input(node, "y"), slot + 2));
+
+				Op op;
+				op.Run = &NoiseGraph::_RunWarp;
+				op.Out = slot;
+				op.In[0] = slot + 1;
+				op.In[1] = slot + 2;
+				op.Params[0] = node.value("strength", 16.f);
+				op.Generator = generator;
+				Graph.m_Ops.push_back(op);
+				return highest;
+			}
+
+			if (type == "curve")
+			{
+				static const std::unordered_map<std::string, Kernel> Curves = {
+					{ "linear", &NoiseGraph::_RunCurve<LinearCurve> },
+					{ "sin", &NoiseGraph::_RunCurve<Math::SinSmooth> },
+					{ "sin_in", &NoiseGraph::_RunCurve<Math::SinSmooth_2> },
+					{ "cos", &NoiseGraph::_RunCurve<Math::CosSmooth> },
+					{ "cubic", &NoiseGraph::_RunCurve<Math::CubicSmooth> },
+					{ "cubic_out", &NoiseGraph::_RunCurve<Math::CubicSmooth_2> },
+					{ "smoothstep", &NoiseGraph::_RunCurve<Math::CubicSmooth_3> },
+					{ "smootherstep", &NoiseGraph::_RunCurve<Math::CubicSmooth_4> },
+				};
+
+				const std::string name = node.value("curve", std::string("linear"));
+				auto curve = Curves.find(name);
+				if (curve == Curves.end())
+				{
+					throw GraphError("unknown curve " + name);
+				}
+
+				const auto from = Range(node, "from", -1.f, 1.f);
+				const auto to = Range(node, "to", 0.f, 1.f);
+				if (from.first == from.second)
+				{
+					throw GraphError("curve has an empty from range");
+				}
+
+				const int highest = Compile(Input(node, "input"), slot);
+				Op op;
+				op.Run = curve->second;
+				op.Out = slot;
+				op.In[0] = slot;
+				op.Params[0] = from.first;
+				op.Params[1] = from.second;
+				op.Params[2] = to.first;
+				op.Params[3] = to.second;
+				Graph.m_Ops.push_back(op);
+				return highest;
+			}
+
+			if (type == "blend")
+			{
+				const json& t = Input(node, "t");
+				int highest = std::max(Compile(Input(node, "a"), slot), Compile(Input(node, "b"), slot + 1));
+
+				Op op;
+				op.Out = slot;
+				op.In[0] = slot;
+				op.In[1] = slot + 1;
+				if (t.is_number())
+				{
+					op.Run = &NoiseGraph::_RunBlend<true>;
+					op.Params[0] = t.get<float>();
+				}
+				else
+				{
+					highest = std::max(highest, Compile(t, slot + 2));
+					op.Run = &NoiseGraph::_RunBlend<false>;
+					op.In[2] = slot + 2;
+				}
+				Graph.m_Ops.push_back(op);
+				return highest;
+			}
+
+			if (type == "clamp")
+			{
+				const int highest = Compile(Input(node, "input"), slot);
+				Op op;
+				op.Run = &NoiseGraph::_RunClamp;
+				op.Out = slot;
+				op.In[0] = slot;
+				op.Params[0] = node.value("min", 0.f);
+				op.Params[1] = node.value("max", 1.f);
+				Graph.m_Ops.push_back(op);
+				return highest;
+			}
+
+			throw GraphError("unknown node type " + type);
+		}
+
+		int AddGenerator(const json& node)
+		{
+			const std::string type = node.is_object() ? node.value("type", std::string()) : std::string();
+			if (type != "perlin" && type != "ridged")
+			{
+				throw GraphError("expected a perlin or ridged node: " + node.dump());
+			}
+
+			const int octaves = std::clamp(node.value("octaves", 5), 1, MaxOctaves);
+			const float scale = node.value("scale", 0.025f);
+			const float persistence = node.value("persistence", 0.5f);
+			const auto offset = Range(node, "offset", 0.f, 0.f);
+
+			Generator generator;
+			generator.FirstNoise = static_cast<int>(Graph.m_Noises.size());
+
+			if (type == "perlin")
+			{
+				// PerlinNoise runs one octave less than it is given
+				Math::PerlinNoise noise(octaves + 1, persistence);
+				noise.setScale(scale);
+				noise.setXOffset(offset.first);
+				noise.setYOffset(offset.second);
+				Graph.m_Noises.push_back(noise);
+				generator.NoiseCount = 1;
+			}
+			else
+			{
+				const float lacunarity = node.value("lacunarity", 2.f);
+				generator.Ridged = true;
+				generator.Ridge = node.value("ridge", 1.f);
+				generator.Gain = node.value("gain", 2.f);
+				generator.NoiseCount = octaves;
+
+				float frequency = 1;
+				float amplitude = 1;
+				float total = 0;
+				for (int i = 0; i < octaves; i++)
+				{
+					// Single octave noise, the frequency goes into the scale
+					Math::PerlinNoise noise(2, 1);
+					noise.setScale(scale * frequency);
+					noise.setXOffset(offset.first);
+					noise.setYOffset(offset.second);
+					Graph.m_Noises.push_back(noise);
+					generator.Amplitudes.push_back(amplitude);
+
+					total += amplitude;
+					frequency *= lacunarity;
+					amplitude *= persistence;
+				}
+				generator.Normalize = total > 0 ? 1 / total : 1;
+			}
+
+			Graph.m_Generators.push_back(std::move(generator));
+			return static_cast<int>(Graph.m_Generators.size()) - 1;
+		}
+
+		static const json& Input(const json& node, const char* name)
+		{
+			if (!node.contains(name))
+			{
+				throw GraphError(node["type"].get<std::string>() + " node is missing " + name);
+			}
+			return node[name];
+		}
+
+		static std::pair<float, float> Range(const json& node, const char* name, float a, float b)
+		{
+			if (!node.contains(name))
+			{
+				return { a, b };
+			}
+
+			const json& range = node[name];
+			if (!range.is_array() || range.size() != 2)
+			{
+				throw GraphError(std::string(name) + " has to be an array of two numbers");
+			}
+			return { range[0].get<float>(), range[1].get<float>() };
+		}
+	};
+
+	Ref<NoiseGraph> NoiseGraph::FromJson(const std::string& text)
+	{
+		auto description = nlohmann::json::parse(text, nullptr, false);
+		if (description.is_discarded())
+		{
+			PR_CORE_ERROR("(NoiseGraph) Invalid json");
+			return nullptr;
+		}
+
+		Ref<NoiseGraph> graph(new NoiseGraph());
+		try
+		{
+			Compiler compiler{ *graph };
+			graph->m_Registers = compiler.Compile(description, 0) + 1;
+		}
+		catch (const std::exception& e)
+		{
+			PR_CORE_ERROR("(NoiseGraph) {0}", e.what());
+			return nullptr;
+		}
+
+		// FNV-1a over the normalised description
+		const std::string normalised = description.dump();
+		graph->m_Hash = 14695981039346656037ull;
+		for (char c : normalised)
+		{
+			graph->m_Hash = (graph->m_Hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+		}
+
+		PR_CORE_INFO("(NoiseGraph) Compiled {0} ops into {1} registers", graph->m_Ops.size(), graph->m_Registers);
+		return graph;
+	}
+
+	Ref<NoiseGraph> NoiseGraph::FromFile(const std::string& filepath)
+	{
+		if (!std::filesystem::exists(filepath))
+		{
+			PR_CORE_ERROR("(NoiseGraph) Couldn't find {0}", filepath);
+			return nullptr;
+		}
+		return FromJson(System::ReadFile(filepath));
+	}
+
+	void NoiseGraph::FillRegion(const HeightRegion& region, float* out) const
+	{
+		const size_t count = region.Count();
+
+		Utils::ScratchScope scope;
+		Utils::ScratchVector<float> scratch(count * (m_Registers - 1));
+
+		float* regs[MaxRegisters];
+		regs[0] = out;
+		for (int i = 1; i < m_Registers; i++)
+		{
+			regs[i] = scratch.data() + (i - 1) * count;
+		}
+
+		for (auto& op : m_Ops)
+		{
+			op.Run(*this, op, region, regs);
+		}
+	}
+
+	NoiseParams NoiseGraph::GetParams() const
+	{
+		NoiseParams params;
+		params.Graph = m_Hash;
+		return params;
+	}
+
+	float NoiseGraph::_Sample(const Generator& generator, float x, float z) const
+	{
+		if (!generator.Ridged)
+		{
+			return m_Noises[generator.FirstNoise].Fractal2(x, z);
+		}
+
+		float weight = 1;
+		float total = 0;
+		for (int i = 0; i < generator.NoiseCount; i++)
+		{
+			const float noise = m_Noises[generator.FirstNoise + i].Fractal2(x, z);
+			total += RidgeOctave(noise, weight, generator.Amplitudes[i], generator.Ridge, generator.Gain);
+		}
+		return total * generator.Normalize;
+	}
+
+	void NoiseGraph::_FillGenerator(const Generator& generator, const HeightRegion& region, float* out, float* signal, float* weight) const
+	{
+		if (!generator.Ridged)
+		{
+			m_Noises[generator.FirstNoise].Fractal2Tile(out, region.X, region.Z, region.Width, region.Height, region.Step);
+			return;
+		}
+
+		const size_t count = region.Count();
+		std::fill(out, out + count, 0.f);
+		std::fill(weight, weight + count, 1.f);
+
+		for (int i = 0; i < generator.NoiseCount; i++)
+		{
+			m_Noises[generator.FirstNoise + i].Fractal2Tile(signal, region.X, region.Z, region.Width, region.Height, region.Step);
+			for (size_t s = 0; s < count; s++)
+			{
+				out[s] += RidgeOctave(signal[s], weight[s], generator.Amplitudes[i], generator.Ridge, generator.Gain);
+			}
+		}
+
+		for (size_t s = 0; s < count; s++)
+		{
+			out[s] *= generator.Normalize;
+		}
+	}
+
+	template<Math::prdecimal(*Curve)(Math::prdecimal)>
+	void NoiseGraph::_RunCurve(const NoiseGraph&, const Op& op, const HeightRegion& region, float* const* regs)
+	{
+		const float* in = regs[op.In[0]];
+		float* out = regs[op.Out];
+		const float from0 = op.Params[0], from1 = op.Params[1];
+		const float to0 = op.Params[2], to1 = op.Params[3];
+
+		const size_t count = region.Count();
+		for (size_t i = 0; i < count; i++)
+		{
+			const float t = std::clamp(static_cast<float>(Math::LinearTranslate(from0, from1, 0.f, 1.f, in[i])), 0.f, 1.f);
+			out[i] = to0 + (to1 - to0) * static_cast<float>(Curve(t));
+		}
+	}
+
+	template<bool ConstantWeight>
+	void NoiseGraph::_RunBlend(const NoiseGraph&, const Op& op, const HeightRegion& region, float* const* regs)
+	{
+		const float* a = regs[op.In[0]];
+		const float* b = regs[op.In[1]];
+		const float* t = ConstantWeight ? nullptr : regs[op.In[2]];
+		float* out = regs[op.Out];
+
+		const size_t count = region.Count();
+		for (size_t i = 0; i < count; i++)
+		{
+			const float weight = ConstantWeight ? op.Params[0] : t[i];
+			out[i] = static_cast<float>(Math::LinearInterpolate(a[i], b[i], weight));
+		}
+	}
+
+	void NoiseGraph::_RunConstant(const NoiseGraph&, const Op& op, const HeightRegion& region, float* const* regs)
+	{
+		std::fill(regs[op.Out], regs[op.Out] + region.Count(), op.Params[0]);
+	}
+
+	void NoiseGraph::_RunGenerator(const NoiseGraph& graph, const Op& op, const HeightRegion& region, float* const* regs)
+	{
+		const Generator& generator = graph.m_Generators[op.Generator];
+		graph._FillGenerator(generator, region, regs[op.Out],
+			generator.Ridged ? regs[op.In[0]] : nullptr,
+			generator.Ridged ? regs[op.In[1]] : nullptr);
+	}
+
+	void NoiseGraph::_RunWarp(const NoiseGraph& graph, const Op& op, const HeightRegion& region, float* const* regs)
+	{
+		const Generator& generator = graph.m_Generators[op.Generator];
+		const float* dx = regs[op.In[0]];
+		const float* dz = regs[op.In[1]];
+		float* out = regs[op.Out];
+		const float strength = op.Params[0];
+
+		// Warped coordinates are off the grid, so the source is sampled one by one
+		for (int z = 0; z < region.Height; z++)
+		{
+			for (int x = 0; x < region.Width; x++)
+			{
+				const size_t i = static_cast<size_t>(z) * region.Width + x;
+				const float wx = static_cast<float>(region.X + x * region.Step) + strength * dx[i];
+				const float wz = static_cast<float>(region.Z + z * region.Step) + strength * dz[i];
+				out[i] = graph._Sample(generator, wx, wz);
+			}
+		}
+	}
+
+	void NoiseGraph::_RunClamp(const NoiseGraph&, const Op& op, const HeightRegion& region, float* const* regs)
+	{
+		const float* in = regs[op.In[0]];
+		float* out = regs[op.Out];
+		const float low = op.Params[0], high = op.Params[1];
+
+		const size_t count = region.Count();
+		for (size_t i = 0; i < count; i++)
+		{
+			out[i] = std::clamp(in[i], low, high);
+		}
+	}
+}
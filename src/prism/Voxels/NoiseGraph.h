@@ -0,0 +1,85 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "HeightSource.h"
+#include "PerlinHeightSource.h"
+#include "prism/Core/Pointers.h"
+#include "prism/Math/PerlinNoise.h"
+
+namespace Prism::Voxel
+{
+	// Height source built from a tree of noise nodes described in json, e.g.
+	//   { "type": "clamp", "min": 0, "max": 1, "input": { "type": "perlin", "scale": 0.02 } }
+	// Nodes:
+	//   perlin  scale, octaves, persistence, offset [x, z]
+	//   ridged  scale, octaves, persistence, lacunarity, gain, ridge, offset [x, z]
+	//   warp    input (perlin or ridged), x, y, strength
+	//   curve   input, curve, from [a, b], to [a, b]
+	//   blend   a, b, t
+	//   clamp   input, min, max
+	// Any input can be a number instead of a node.
+	// The tree is compiled into a flat list of ops, each one a kernel
+	// specialised at compile time that runs over the whole tile. Op results
+	// live in per thread tile registers, so evaluating allocates nothing
+	class NoiseGraph final : public IHeightSource
+	{
+	public:
+		// Both log the problem and return nullptr for an invalid graph
+		static Ref<NoiseGraph> FromJson(const std::string& text);
+		static Ref<NoiseGraph> FromFile(const std::string& filepath);
+
+		void FillRegion(const HeightRegion& region, float* out) const override;
+
+		// Only Graph is set, it hashes the whole description
+		NoiseParams GetParams() const;
+		size_t GetOpCount() const { return m_Ops.size(); }
+		int GetRegisterCount() const { return m_Registers; }
+	private:
+		struct Op;
+		struct Compiler;
+		using Kernel = void(*)(const NoiseGraph& graph, const Op& op, const HeightRegion& region, float* const* regs);
+
+		// Perlin or ridged noise, also evaluated per sample by warps
+		struct Generator
+		{
+			bool Ridged{ false };
+			// Perlin uses one fractal noise, ridged one single octave noise per octave
+			int FirstNoise{ 0 };
+			int NoiseCount{ 0 };
+			std::vector<float> Amplitudes;
+			float Ridge{ 1 };
+			float Gain{ 2 };
+			float Normalize{ 1 };
+		};
+
+		struct Op
+		{
+			Kernel Run{ nullptr };
+			int Out{ 0 };
+			int In[3]{ 0, 0, 0 };
+			float Params[4]{ 0, 0, 0, 0 };
+			int Generator{ -1 };
+		};
+
+		NoiseGraph() = default;
+
+		float _Sample(const Generator& generator, float x, float z) const;
+		void _FillGenerator(const Generator& generator, const HeightRegion& region, float* out, float* signal, float* weight) const;
+
+		template<Math::prdecimal(*Curve)(Math::prdecimal)>
+		static void _RunCurve(const NoiseGraph& graph, const Op& op, const HeightRegion& region, float* const* regs);
+		template<bool ConstantWeight>
+		static void _RunBlend(const NoiseGraph& graph, const Op& op, const HeightRegion& region, float* const* regs);
+		static void _RunConstant(const NoiseGraph& graph, const Op& op, const HeightRegion& region, float* const* regs);
+		static void _RunGenerator(const NoiseGraph& graph, const Op& op, const HeightRegion& region, float* const* regs);
+		static void _RunWarp(const NoiseGraph& graph, const Op& op, const HeightRegion& region, float* const* regs);
+		static void _RunClamp(const NoiseGraph& graph, const Op& op, const HeightRegion& region, float* const* regs);
+
+		std::vector<Op> m_Ops;
+		std::vector<Generator> m_Generators;
+		std::vector<Math::PerlinNoise> m_Noises;
+		int m_Registers{ 1 };
+		uint64_t m_Hash{ 0 };
+	};
+}
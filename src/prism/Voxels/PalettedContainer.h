@@ -0,0 +1,251 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "prism/System/Debug.h"
+
+namespace Prism::Voxel
+{
+	// Stores values as indices into a small palette, bit packed into 64 bit words.
+	// Indices start at 1 bit and grow (1, 2, 4, 8, 16) as new values show up,
+	// an index never straddles two words.
+	// T has to be cheap to copy and comparable (block types, ids)
+	template<typename T>
+	class PalettedContainer
+	{
+	public:
+		static constexpr int MaxBits = 16;
+		
+		PalettedContainer() = default;
+		
+		PalettedContainer(size_t size, T value = T{})
+		{
+			Resize(size, value);
+		}
+
+		// Drops all data, every element ends up as value
+		void Resize(size_t size, T value = T{})
+		{
+			m_Size = size;
+			m_Palette.assign(1, value);
+			_SetBits(1);
+			m_Data.assign(_WordCount(m_Size), 0);
+		}
+
+		// Bulk fill, also shrinks the palette back to a single entry
+		void Fill(T value)
+		{
+			m_Palette.assign(1, value);
+			if (m_BitsLog != 0)
+			{
+				_SetBits(1);
+				m_Data.assign(_WordCount(m_Size), 0);
+				return;
+			}
+			std::fill(m_Data.begin(), m_Data.end(), 0);
+		}
+
+		T Get(size_t i) const
+		{
+			PR_ASSERT(i < m_Size, "(PalettedContainer) Index out of range");
+			return m_Palette[_GetIndex(i)];
+		}
+
+		void Set(size_t i, T value)
+		{
+			PR_ASSERT(i < m_Size, "(PalettedContainer) Index out of range");
+			_SetIndex(i, _PaletteIndex(value));
+		}
+
+		// Sets [start, start + count) to value, whole words are written at once
+		void FillRun(size_t start, size_t count, T value)
+		{
+			PR_ASSERT(start + count <= m_Size, "(PalettedContainer) Run out of range");
+			if (count == 0)
+			{
+				return;
+			}
+
+			uint64_t idx = _PaletteIndex(value);
+			size_t end = start + count;
+			size_t perWord = _PerWord();
+			
+			// Unaligned head
+			while (start < end && (start & (perWord - 1)) != 0)
+			{
+				_SetIndex(start++, idx);
+			}
+
+			uint64_t pattern = _Replicate(idx);
+			while (start + perWord <= end)
+			{
+				m_Data[start >> m_PerWordLog] = pattern;
+				start += perWord;
+			}
+
+			// Tail
+			while (start < end)
+			{
+				_SetIndex(start++, idx);
+			}
+		}
+
+		// Number of consecutive elements equal to the one at start,
+		// looks at no more than max elements
+		size_t RunLength(size_t start, size_t max) const
+		{
+			PR_ASSERT(start < m_Size, "(PalettedContainer) Index out of range");
+			size_t end = std::min(m_Size, start + max);
+			uint64_t idx = _GetIndex(start);
+			uint64_t pattern = _Replicate(idx);
+			size_t perWord = _PerWord();
+			size_t i = start + 1;
+
+			while (i < end)
+			{
+				if ((i & (perWord - 1)) == 0 && i + perWord <= end && m_Data[i >> m_PerWordLog] == pattern)
+				{
+					i += perWord;
+					continue;
+				}
+				if (_GetIndex(i) != idx)
+				{
+					break;
+				}
+				i++;
+			}
+
+			return i - start;
+		}
+
+		void Clear()
+		{
+			m_Size = 0;
+			m_Data.clear();
+			m_Data.shrink_to_fit();
+			m_Palette.clear();
+		}
+
+		size_t Size() const
+		{
+			return m_Size;
+		}
+
+		int GetBitsPerIndex() const
+		{
+			return 1 << m_BitsLog;
+		}
+
+		const std::vector<T>& GetPalette() const
+		{
+			return m_Palette;
+		}
+
+		const std::vector<uint64_t>& GetData() const
+		{
+			return m_Data;
+		}
+
+		size_t MemorySize() const
+		{
+			return m_Data.size() * sizeof(uint64_t) + m_Palette.size() * sizeof(T);
+		}
+	private:
+		size_t _PerWord() const
+		{
+			return size_t(1) << m_PerWordLog;
+		}
+
+		size_t _WordCount(size_t size) const
+		{
+			return (size + _PerWord() - 1) >> m_PerWordLog;
+		}
+
+		void _SetBits(int bits)
+		{
+			m_BitsLog = 0;
+			while ((1 << m_BitsLog) < bits)
+			{
+				m_BitsLog++;
+			}
+			m_PerWordLog = 6 - m_BitsLog;
+			m_Mask = (uint64_t(1) << (1 << m_BitsLog)) - 1;
+		}
+
+		uint64_t _Replicate(uint64_t idx) const
+		{
+			uint64_t pattern = 0;
+			int bits = 1 << m_BitsLog;
+			for (int shift = 0; shift < 64; shift += bits)
+			{
+				pattern |= idx << shift;
+			}
+			return pattern;
+		}
+
+		uint64_t _GetIndex(size_t i) const
+		{
+			int shift = static_cast<int>(i & (_PerWord() - 1)) << m_BitsLog;
+			return (m_Data[i >> m_PerWordLog] >> shift) & m_Mask;
+		}
+
+		void _SetIndex(size_t i, uint64_t idx)
+		{
+			int shift = static_cast<int>(i & (_PerWord() - 1)) << m_BitsLog;
+			uint64_t& word = m_Data[i >> m_PerWordLog];
+			word = (word & ~(m_Mask << shift)) | (idx << shift);
+		}
+
+		uint64_t _PaletteIndex(const T& value)
+		{
+			for (size_t i = 0; i < m_Palette.size(); i++)
+			{
+				if (m_Palette[i] == value)
+				{
+					return i;
+				}
+			}
+
+			m_Palette.push_back(value);
+			if (m_Palette.size() > (size_t(1) << (1 << m_BitsLog)))
+			{
+				_Grow();
+			}
+			return m_Palette.size() - 1;
+		}
+
+		// Repacks into the next index width
+		void _Grow()
+		{
+			PR_ASSERT((1 << m_BitsLog) < MaxBits, "(PalettedContainer) Palette is full");
+			
+			std::vector<uint64_t> old;
+			old.swap(m_Data);
+			int oldBitsLog = m_BitsLog;
+			int oldPerWordLog = m_PerWordLog;
+			uint64_t oldMask = m_Mask;
+
+			_SetBits(2 << m_BitsLog);
+			m_Data.assign(_WordCount(m_Size), 0);
+
+			size_t oldPerWord = size_t(1) << oldPerWordLog;
+			for (size_t i = 0; i < m_Size; i++)
+			{
+				int shift = static_cast<int>(i & (oldPerWord - 1)) << oldBitsLog;
+				uint64_t idx = (old[i >> oldPerWordLog] >> shift) & oldMask;
+				if (idx != 0)
+				{
+					_SetIndex(i, idx);
+				}
+			}
+		}
+		
+		std::vector<uint64_t> m_Data;
+		std::vector<T> m_Palette;
+		size_t m_Size{ 0 };
+		int m_BitsLog{ 0 };
+		int m_PerWordLog{ 6 };
+		uint64_t m_Mask{ 1 };
+	};
+}
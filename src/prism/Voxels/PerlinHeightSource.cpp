@@ -0,0 +1,31 @@
+#include "PerlinHeightSource.h"
+
+namespace Prism::Voxel
+{
+	PerlinHeightSource::PerlinHeightSource(const Math::PerlinNoise& noise)
+		:
+		m_Noise(noise)
+	{}
+
+	void PerlinHeightSource::FillRegion(const HeightRegion& region, float* out) const
+	{
+		m_Noise.Fractal2Tile(out, region.X, region.Z, region.Width, region.Height, region.Step);
+
+		const size_t count = region.Count();
+		for (size_t i = 0; i < count; i++)
+		{
+			out[i] = (out[i] + 1) / 2;
+		}
+	}
+
+	NoiseParams PerlinHeightSource::GetParams() const
+	{
+		NoiseParams params;
+		params.Scale = m_Noise.getScale();
+		params.XOffset = m_Noise.getXOffset();
+		params.YOffset = m_Noise.getYOffset();
+		params.Octaves = m_Noise.getOctaves();
+		params.Persistence = m_Noise.getPersistence();
+		return params;
+	}
+}
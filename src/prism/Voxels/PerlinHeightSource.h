@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+
+#include "HeightSource.h"
+#include "prism/Math/PerlinNoise.h"
+
+namespace Prism::Voxel
+{
+	// Everything a noise height source depends on, used to key cached tiles
+	struct NoiseParams
+	{
+		float Scale{ 0 };
+		float XOffset{ 0 };
+		float YOffset{ 0 };
+		unsigned Octaves{ 0 };
+		float Persistence{ 0 };
+		// Hash of a noise graph description, 0 for plain noise
+		uint64_t Graph{ 0 };
+
+		bool operator==(const NoiseParams& other) const
+		{
+			return Scale == other.Scale && XOffset == other.XOffset && YOffset == other.YOffset &&
+				Octaves == other.Octaves && Persistence == other.Persistence && Graph == other.Graph;
+		}
+	};
+
+	// Fractal perlin noise remapped to [0, 1], evaluated a tile at a time.
+	// Holds a copy of the noise, changing the original afterwards doesn't
+	// affect jobs that are still sampling
+	class PerlinHeightSource final : public IHeightSource
+	{
+	public:
+		PerlinHeightSource(const Math::PerlinNoise& noise);
+
+		void FillRegion(const HeightRegion& region, float* out) const override;
+
+		NoiseParams GetParams() const;
+	private:
+		Math::PerlinNoise m_Noise;
+	};
+}
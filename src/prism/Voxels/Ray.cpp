@@ -0,0 +1,256 @@
+#include "Ray.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include "prism/System/ParallelFor.h"
+
+namespace Prism::Voxel
+{
+	namespace
+	{
+		constexpr float Infinity = std::numeric_limits<float>::infinity();
+
+		// One axis of a 2D DDA, t is measured from the ray origin
+		struct DdaAxis
+		{
+			int cell;
+			int step;
+			float tMax;
+			float tDelta;
+
+			void Init(float origin, float dir, float position, float cellSize, int minCell, int maxCell)
+			{
+				cell = glm::clamp(static_cast<int>(std::floor(position / cellSize)), minCell, maxCell);
+				if (dir > 0.f)
+				{
+					step = 1;
+					tMax = ((cell + 1) * cellSize - origin) / dir;
+					tDelta = cellSize / dir;
+				}
+				else if (dir < 0.f)
+				{
+					step = -1;
+					tMax = (cell * cellSize - origin) / dir;
+					tDelta = -cellSize / dir;
+				}
+				else
+				{
+					step = 0;
+					tMax = Infinity;
+					tDelta = Infinity;
+				}
+			}
+		};
+
+		constexpr int AxisX = 0;
+		constexpr int AxisZ = 1;
+		constexpr int AxisNone = -1;
+	}
+
+	Raycaster::Raycaster(int ChunkSize, int BlockSize, ChunkLookup lookup)
+		:
+		m_ChunkSize(ChunkSize),
+		m_BlockSize(BlockSize),
+		m_ChunkExtent(static_cast<float>(ChunkSize * BlockSize)),
+		m_Lookup(std::move(lookup))
+	{
+	}
+
+	RayHit Raycaster::Trace(const Ray& ray) const
+	{
+		RayHit hit;
+
+		const float length = glm::length(ray.Direction);
+		if (length == 0.f)
+		{
+			return hit;
+		}
+
+		const glm::vec3 o = ray.Origin;
+		const glm::vec3 d = ray.Direction / length;
+		const float tEnd = ray.MaxDistance;
+
+		DdaAxis ax, az;
+		ax.Init(o.x, d.x, o.x, m_ChunkExtent, INT_MIN, INT_MAX);
+		az.Init(o.z, d.z, o.z, m_ChunkExtent, INT_MIN, INT_MAX);
+
+		float t = 0.f;
+		int enterAxis = AxisNone;
+		while (t <= tEnd)
+		{
+			const float tExit = std::min({ ax.tMax, az.tMax, tEnd });
+			const Vec2 coord{ ax.cell, az.cell };
+
+			if (const Chunk* chunk = m_Lookup(coord))
+			{
+				// Skip chunks the ray passes over
+				const float top = (chunk->GetMaxHeight() + 1) * static_cast<float>(chunk->GetBlockSize());
+				const float y0 = o.y + d.y * t;
+				const float y1 = o.y + d.y * tExit;
+				if (std::min(y0, y1) < top && _TraceChunk(*chunk, coord, o, d, t, tExit, enterAxis, hit))
+				{
+					return hit;
+				}
+			}
+
+			if (tExit >= tEnd)
+			{
+				break;
+			}
+
+			if (ax.tMax < az.tMax)
+			{
+				t = ax.tMax;
+				ax.cell += ax.step;
+				ax.tMax += ax.tDelta;
+				enterAxis = AxisX;
+			}
+			else
+			{
+				t = az.tMax;
+				az.cell += az.step;
+				az.tMax += az.tDelta;
+				enterAxis = AxisZ;
+			}
+		}
+
+		return hit;
+	}
+
+	bool Raycaster::_TraceChunk(const Chunk& chunk, const Vec2& coord, const glm::vec3& o, const glm::vec3& d,
+		float tEnter, float tExit, int enterAxis, RayHit& hit) const
+	{
+		const float bs = static_cast<float>(chunk.GetBlockSize());
+		const int lod = chunk.GetLod();
+		const int columns = m_ChunkSize >> lod;
+
+		// Walk in chunk local coordinates so the cells start at 0
+		const float lox = o.x - coord.x * m_ChunkExtent;
+		const float loz = o.z - coord.y * m_ChunkExtent;
+
+		DdaAxis ax, az;
+		ax.Init(lox, d.x, lox + d.x * tEnter, bs, 0, columns - 1);
+		az.Init(loz, d.z, loz + d.z * tEnter, bs, 0, columns - 1);
+
+		float t = tEnter;
+		int axis = enterAxis;
+		while (true)
+		{
+			const float t1 = std::min({ ax.tMax, az.tMax, tExit });
+			const int height = chunk.GetHeight(ax.cell, az.cell);
+			const float top = (height + 1) * bs;
+
+			const float y0 = o.y + d.y * t;
+			const float y1 = o.y + d.y * t1;
+
+			float tHit;
+			int level;
+			Chunk::Face face;
+			if (y0 < top)
+			{
+				// Went in through a side, or started inside the column
+				tHit = t;
+				level = glm::clamp(static_cast<int>(std::floor(y0 / bs)), 0, height);
+				if (axis == AxisX)
+				{
+					face = ax.step > 0 ? Chunk::Face::RIGHT : Chunk::Face::LEFT;
+				}
+				else if (axis == AxisZ)
+				{
+					face = az.step > 0 ? Chunk::Face::BACK : Chunk::Face::FRONT;
+				}
+				else
+				{
+					face = Chunk::Face::TOP;
+				}
+			}
+			else if (y1 < top)
+			{
+				// Came down through the top within the column
+				tHit = (top - o.y) / d.y;
+				level = height;
+				face = Chunk::Face::TOP;
+			}
+			else
+			{
+				if (t1 >= tExit)
+				{
+					return false;
+				}
+
+				if (ax.tMax < az.tMax)
+				{
+					t = ax.tMax;
+					ax.cell += ax.step;
+					ax.tMax += ax.tDelta;
+					axis = AxisX;
+				}
+				else
+				{
+					t = az.tMax;
+					az.cell += az.step;
+					az.tMax += az.tDelta;
+					axis = AxisZ;
+				}
+
+				if (ax.cell < 0 || ax.cell >= columns || az.cell < 0 || az.cell >= columns)
+				{
+					return false;
+				}
+				continue;
+			}
+
+			const int step = 1 << lod;
+			hit.Hit = true;
+			hit.Distance = tHit;
+			hit.Position = o + d * tHit;
+			hit.Block = glm::ivec3{
+				coord.x * m_ChunkSize + ax.cell * step,
+				level * step,
+				coord.y * m_ChunkSize + az.cell * step
+			};
+			hit.Face = face;
+			hit.ChunkCoord = coord;
+			hit.Lod = lod;
+			return true;
+		}
+	}
+
+	bool Raycaster::LineOfSight(const glm::vec3& from, const glm::vec3& to) const
+	{
+		const glm::vec3 delta = to - from;
+		const float distance = glm::length(delta);
+		if (distance == 0.f)
+		{
+			return true;
+		}
+
+		Ray ray;
+		ray.Origin = from;
+		ray.Direction = delta / distance;
+		ray.MaxDistance = distance;
+		return !Trace(ray).Hit;
+	}
+
+	void Raycaster::TraceBatch(const Ray* rays, RayHit* hits, size_t count, System::ThreadPool* pool) const
+	{
+		if (!pool || count <= BatchSlice)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				hits[i] = Trace(rays[i]);
+			}
+			return;
+		}
+
+		System::ParallelFor(*pool, 0, count, BatchSlice, [&](size_t first, size_t last)
+			{
+				for (size_t i = first; i < last; i++)
+				{
+					hits[i] = Trace(rays[i]);
+				}
+			});
+	}
+}
@@ -1,5 +1,67 @@
 #pragma once
+#include <functional>
+#include <limits>
+#include <glm/glm.hpp>
 
-namespace Prism::Voxels
+#include "Chunk.h"
+#include "prism/Core/Pointers.h"
+#include "prism/System/ThreadPool.h"
+
+namespace Prism::Voxel
 {
-}
\ No newline at end of file
+	struct Ray
+	{
+		glm::vec3 Origin{ 0.f, 0.f, 0.f };
+		glm::vec3 Direction{ 0.f, 0.f, 1.f };
+		// Bounds the walk over missing chunks, matches the camera far plane
+		float MaxDistance{ 2048.f };
+	};
+
+	struct RayHit
+	{
+		bool Hit{ false };
+		// World units along the normalized direction
+		float Distance{ 0.f };
+		glm::vec3 Position{ 0.f, 0.f, 0.f };
+		// Full resolution world block, for chunks with a lod this is
+		// the first block of the coarse column
+		glm::ivec3 Block{ 0, 0, 0 };
+		// The face of the block the ray went through
+		Chunk::Face Face{ Chunk::Face::TOP };
+		Vec2 ChunkCoord{ 0, 0 };
+		int Lod{ 0 };
+	};
+
+	// Amanatides-Woo traversal over the column heightmaps of the chunks.
+	// The ray walks the chunk grid first and skips chunks it passes above,
+	// inside a chunk it walks the columns and solves the hit against the
+	// column top analytically, so there is no stepping along y
+	class Raycaster
+	{
+	public:
+		// Returns the chunk at a chunk coordinate or nullptr, skipped chunks count as empty
+		using ChunkLookup = std::function<const Chunk*(const Vec2&)>;
+
+		Raycaster(int ChunkSize, int BlockSize, ChunkLookup lookup);
+
+		RayHit Trace(const Ray& ray) const;
+		bool LineOfSight(const glm::vec3& from, const glm::vec3& to) const;
+
+		// Traces count rays into hits, splitting the batch between the calling
+		// thread and the pool's workers when one is passed. Safe to call from a
+		// worker of that pool, it runs other tasks while it waits. Chunks must
+		// not change until it returns
+		void TraceBatch(const Ray* rays, RayHit* hits, size_t count, System::ThreadPool* pool = nullptr) const;
+
+		static constexpr size_t BatchSlice = 256;
+	private:
+		// Walks the columns of a chunk between tEnter and tExit
+		bool _TraceChunk(const Chunk& chunk, const Vec2& coord, const glm::vec3& origin, const glm::vec3& dir,
+			float tEnter, float tExit, int enterAxis, RayHit& hit) const;
+
+		int m_ChunkSize;
+		int m_BlockSize;
+		float m_ChunkExtent;
+		ChunkLookup m_Lookup;
+	};
+}
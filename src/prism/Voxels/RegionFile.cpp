@@ -0,0 +1,296 @@
+#include "RegionFile.h"
+
+#include <algorithm>
+#include <filesystem>
+
+#include "prism/System/ByteStream.h"
+#include "prism/System/Log.h"
+
+namespace Prism::Voxel
+{
+	RegionFile::RegionFile(const std::string& filepath, uint32_t stamp, int chunkSize)
+		:
+		m_Filepath(filepath),
+		m_Index(RegionSize * RegionSize)
+	{
+		if (_ReadHeader(stamp, chunkSize))
+		{
+			m_File = std::fopen(m_Filepath.c_str(), "r+b");
+		}
+
+		if (!m_File && !_WriteHeader(stamp, chunkSize))
+		{
+			PR_CORE_ERROR("(RegionFile) Failed to create {0}", m_Filepath);
+		}
+	}
+
+	RegionFile::~RegionFile()
+	{
+		m_Map.Close();
+		if (m_File)
+		{
+			std::fclose(m_File);
+		}
+	}
+
+	bool RegionFile::Load(int index, Chunk& chunk)
+	{
+		std::lock_guard<std::mutex> lck(m_Mutex);
+
+		const Entry& entry = m_Index[index];
+		if (entry.size == 0)
+		{
+			return false;
+		}
+
+		// The mapping only covers what was on disk when it was opened
+		if (static_cast<size_t>(entry.offset) + entry.size > m_Map.Size() && !m_Map.Open(m_Filepath))
+		{
+			return false;
+		}
+
+		if (!chunk.Deserialize(m_Map.Data() + entry.offset, entry.size))
+		{
+			PR_CORE_WARN("(RegionFile) Corrupt chunk {0} in {1}", index, m_Filepath);
+			return false;
+		}
+		return true;
+	}
+
+	bool RegionFile::Write(int index, const std::vector<uint8_t>& payload)
+	{
+		std::lock_guard<std::mutex> lck(m_Mutex);
+
+		if (!m_File || payload.empty())
+		{
+			return false;
+		}
+
+		const Entry entry{ m_End, static_cast<uint32_t>(payload.size()) };
+
+		std::vector<uint8_t> bytes;
+		System::ByteWriter w(bytes);
+		w.U32(entry.offset);
+		w.U32(entry.size);
+
+		// Payload first, a crash in between leaves the old entry valid
+		if (std::fseek(m_File, static_cast<long>(entry.offset), SEEK_SET) != 0 ||
+			std::fwrite(payload.data(), 1, payload.size(), m_File) != payload.size() ||
+			std::fseek(m_File, static_cast<long>(HeaderSize + index * bytes.size()), SEEK_SET) != 0 ||
+			std::fwrite(bytes.data(), 1, bytes.size(), m_File) != bytes.size() ||
+			std::fflush(m_File) != 0)
+		{
+			PR_CORE_ERROR("(RegionFile) Failed to write chunk {0} to {1}", index, m_Filepath);
+			return false;
+		}
+
+		m_Index[index] = entry;
+		m_End += entry.size;
+		return true;
+	}
+
+	int RegionFile::IndexOf(const Vec2& coord)
+	{
+		const int x = coord.x & (RegionSize - 1);
+		const int z = coord.y & (RegionSize - 1);
+		return z * RegionSize + x;
+	}
+
+	bool RegionFile::_ReadHeader(uint32_t stamp, int chunkSize)
+	{
+		if (!m_Map.Open(m_Filepath) || m_Map.Size() < HeaderSize + IndexSize)
+		{
+			m_Map.Close();
+			return false;
+		}
+
+		System::ByteReader r(m_Map.Data(), m_Map.Size());
+		if (r.U32() != Magic || r.U32() != Version || r.U32() != stamp || r.U32() != static_cast<uint32_t>(chunkSize))
+		{
+			PR_CORE_INFO("(RegionFile) {0} is outdated, recreating it", m_Filepath);
+			m_Map.Close();
+			return false;
+		}
+
+		for (auto& entry : m_Index)
+		{
+			entry.offset = r.U32();
+			entry.size = r.U32();
+			if (static_cast<size_t>(entry.offset) + entry.size > m_Map.Size())
+			{
+				entry = Entry{};
+			}
+		}
+
+		m_End = static_cast<uint32_t>(m_Map.Size());
+		return true;
+	}
+
+	bool RegionFile::_WriteHeader(uint32_t stamp, int chunkSize)
+	{
+		m_Map.Close();
+		std::fill(m_Index.begin(), m_Index.end(), Entry{});
+
+		m_File = std::fopen(m_Filepath.c_str(), "w+b");
+		if (!m_File)
+		{
+			return false;
+		}
+
+		std::vector<uint8_t> header;
+		header.reserve(HeaderSize + IndexSize);
+		System::ByteWriter w(header);
+		w.U32(Magic);
+		w.U32(Version);
+		w.U32(stamp);
+		w.U32(static_cast<uint32_t>(chunkSize));
+		header.resize(HeaderSize + IndexSize, 0);
+
+		if (std::fwrite(header.data(), 1, header.size(), m_File) != header.size() || std::fflush(m_File) != 0)
+		{
+			std::fclose(m_File);
+			m_File = nullptr;
+			return false;
+		}
+
+		m_End = static_cast<uint32_t>(header.size());
+		return true;
+	}
+
+	RegionStore::RegionStore(const std::string& directory, uint32_t stamp, int chunkSize, Ref<System::ThreadPool> writer)
+		:
+		m_Directory(directory),
+		m_Stamp(stamp),
+		m_ChunkSize(chunkSize),
+		m_Writer(std::move(writer))
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(m_Directory, ec);
+		if (ec)
+		{
+			PR_CORE_ERROR("(RegionStore) Failed to create {0}: {1}", m_Directory, ec.message());
+		}
+	}
+
+	RegionStore::~RegionStore()
+	{
+		Flush();
+	}
+
+	bool RegionStore::Load(const Vec2& coord, Chunk& chunk)
+	{
+		Ref<std::vector<uint8_t>> pending;
+		RegionFile* region = nullptr;
+		{
+			std::lock_guard<std::mutex> lck(m_Mutex);
+			auto itr = m_Pending.find(coord);
+			if (itr != m_Pending.end())
+			{
+				pending = itr->second;
+			}
+			else
+			{
+				region = _GetRegion(coord, false);
+			}
+		}
+
+		const bool loaded = pending
+			? chunk.Deserialize(pending->data(), pending->size())
+			: region && region->Load(RegionFile::IndexOf(coord), chunk);
+
+		if (loaded)
+		{
+			std::lock_guard<std::mutex> lck(m_Mutex);
+			m_Stats.Loaded++;
+		}
+		return loaded;
+	}
+
+	void RegionStore::Save(const Vec2& coord, std::vector<uint8_t>&& payload)
+	{
+		auto data = MakeRef<std::vector<uint8_t>>(std::move(payload));
+
+		std::lock_guard<std::mutex> lck(m_Mutex);
+		m_Pending[coord] = data;
+
+		m_Writes.erase(std::remove_if(m_Writes.begin(), m_Writes.end(), [](const std::future<void>& write)
+			{
+				return write.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+			}), m_Writes.end());
+
+		m_Writes.push_back(m_Writer->QueueTask([this, coord, data]()
+			{
+				RegionFile* region;
+				{
+					std::lock_guard<std::mutex> lck(m_Mutex);
+					region = _GetRegion(coord, true);
+				}
+
+				const bool written = region && region->Write(RegionFile::IndexOf(coord), *data);
+
+				std::lock_guard<std::mutex> lck(m_Mutex);
+				// A newer save of the same chunk stays pending
+				auto itr = m_Pending.find(coord);
+				if (itr != m_Pending.end() && itr->second == data)
+				{
+					m_Pending.erase(itr);
+				}
+				if (written)
+				{
+					m_Stats.Saved++;
+					m_Stats.BytesWritten += data->size();
+				}
+			}));
+	}
+
+	void RegionStore::Flush()
+	{
+		std::vector<std::future<void>> writes;
+		{
+			std::lock_guard<std::mutex> lck(m_Mutex);
+			writes.swap(m_Writes);
+		}
+
+		for (auto& write : writes)
+		{
+			write.wait();
+		}
+	}
+
+	RegionStore::Stats RegionStore::GetStats()
+	{
+		std::lock_guard<std::mutex> lck(m_Mutex);
+		Stats stats = m_Stats;
+		stats.Regions = static_cast<int>(m_Regions.size());
+		stats.PendingWrites = static_cast<int>(m_Pending.size());
+		return stats;
+	}
+
+	RegionFile* RegionStore::_GetRegion(const Vec2& coord, bool create)
+	{
+		const Vec2 region{
+			coord.x >= 0 ? coord.x / RegionFile::RegionSize : (coord.x + 1) / RegionFile::RegionSize - 1,
+			coord.y >= 0 ? coord.y / RegionFile::RegionSize : (coord.y + 1) / RegionFile::RegionSize - 1
+		};
+
+		auto itr = m_Regions.find(region);
+		if (itr != m_Regions.end())
+		{
+			return itr->second.get();
+		}
+
+		const std::string filepath = m_Directory + "/r." + std::to_string(region.x) + "." + std::to_string(region.y) + ".bin";
+		// Loads never create files, a missing region just means nothing was saved yet
+		if (!create && !std::filesystem::exists(filepath))
+		{
+			return nullptr;
+		}
+
+		auto file = MakePtr<RegionFile>(filepath, m_Stamp, m_ChunkSize);
+		if (!file->IsOpen())
+		{
+			return nullptr;
+		}
+		return m_Regions.emplace(region, std::move(file)).first->second.get();
+	}
+}
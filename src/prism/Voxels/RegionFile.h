@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdio>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Chunk.h"
+#include "prism/Core/Pointers.h"
+#include "prism/System/MappedFile.h"
+#include "prism/System/ThreadPool.h"
+
+namespace Prism::Voxel
+{
+	// One file holding RegionSize x RegionSize chunks.
+	// Layout: u32 magic, u32 version, u32 stamp, u32 chunk size, followed by
+	// an index of {u32 offset, u32 size} per chunk. Payloads are appended and
+	// read back through a memory mapping, rewritten chunks leave their old
+	// payload behind as unused space
+	class RegionFile
+	{
+	public:
+		static constexpr int RegionSize = 32;
+		static constexpr uint32_t Magic = 0x47525250; // "PRRG"
+		static constexpr uint32_t Version = 1;
+
+		// Files written with another version, stamp or chunk size are recreated
+		RegionFile(const std::string& filepath, uint32_t stamp, int chunkSize);
+		~RegionFile();
+
+		RegionFile(const RegionFile&) = delete;
+		RegionFile& operator=(const RegionFile&) = delete;
+
+		bool IsOpen() const { return m_File != nullptr; }
+		// Deserializes the stored payload into the chunk, false if there is none
+		bool Load(int index, Chunk& chunk);
+		bool Write(int index, const std::vector<uint8_t>& payload);
+
+		static int IndexOf(const Vec2& coord);
+	private:
+		struct Entry
+		{
+			uint32_t offset{ 0 };
+			uint32_t size{ 0 };
+		};
+
+		static constexpr size_t HeaderSize = 16;
+		static constexpr size_t IndexSize = RegionSize * RegionSize * sizeof(uint32_t) * 2;
+
+		bool _ReadHeader(uint32_t stamp, int chunkSize);
+		bool _WriteHeader(uint32_t stamp, int chunkSize);
+
+		std::string m_Filepath;
+		std::FILE* m_File{ nullptr };
+		System::MappedFile m_Map;
+		std::vector<Entry> m_Index;
+		uint32_t m_End{ 0 };
+		std::mutex m_Mutex;
+	};
+
+	// Maps chunk coordinates onto region files in a directory. Saves are copied
+	// into a pending list and written by a background worker, loads see
+	// pending saves before they reach the disk
+	class RegionStore
+	{
+	public:
+		struct Stats
+		{
+			int Regions{ 0 };
+			int PendingWrites{ 0 };
+			size_t Loaded{ 0 };
+			size_t Saved{ 0 };
+			size_t BytesWritten{ 0 };
+		};
+
+		RegionStore(const std::string& directory, uint32_t stamp, int chunkSize, Ref<System::ThreadPool> writer);
+		~RegionStore();
+
+		// Thread safe, called from the chunk jobs
+		bool Load(const Vec2& coord, Chunk& chunk);
+		void Save(const Vec2& coord, std::vector<uint8_t>&& payload);
+		// Blocks until every queued save is on disk
+		void Flush();
+
+		uint32_t GetStamp() const { return m_Stamp; }
+		int GetChunkSize() const { return m_ChunkSize; }
+		Stats GetStats();
+	private:
+		RegionFile* _GetRegion(const Vec2& coord, bool create);
+
+		std::string m_Directory;
+		uint32_t m_Stamp;
+		int m_ChunkSize;
+		Ref<System::ThreadPool> m_Writer;
+		std::mutex m_Mutex;
+		std::unordered_map<Vec2, Ptr<RegionFile>> m_Regions;
+		std::unordered_map<Vec2, Ref<std::vector<uint8_t>>> m_Pending;
+		std::vector<std::future<void>> m_Writes;
+		Stats m_Stats;
+	};
+}